@@ -52,8 +52,6 @@ extern "C" {
 }
 #endif
 
-#include "wrappers/generic-memalign.cpp"
-
 extern "C" {
   
   void * xxmalloc (size_t sz) {
@@ -63,6 +61,10 @@ extern "C" {
     return ptr;
   }
 
+  void * xxmalloc_zeroed (size_t sz) {
+    return getCustomHeap()->malloc_zeroed (sz);
+  }
+
   void xxfree (void * ptr) {
     getCustomHeap()->free (ptr);
   }
@@ -76,13 +78,31 @@ extern "C" {
   }
 
   void * xxmemalign(size_t alignment, size_t sz) {
-    return generic_xxmemalign(alignment, sz);
+    return getCustomHeap()->memalign (alignment, sz);
   }
   
   size_t xxmalloc_usable_size (void * ptr) {
     return getCustomHeap()->getSize (ptr);
   }
 
+  int xxmalloc_try_resize (void * ptr, size_t sz) {
+    return getCustomHeap()->try_resize (ptr, sz);
+  }
+
+  size_t xxmalloc_good_size (size_t sz) {
+    return getCustomHeap()->good_size (sz);
+  }
+
+  size_t xxmalloc_trim (size_t pad) {
+    return HL::trim (*getCustomHeap(), pad);
+  }
+
+  int xxmalloc_get_stats (HL::HeapStats * stats) {
+    stats->clear();
+    HL::collect_stats (*getCustomHeap(), *stats);
+    return 1;
+  }
+
   void xxmalloc_lock() {
     // getCustomHeap()->lock();
   }
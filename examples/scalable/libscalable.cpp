@@ -0,0 +1,151 @@
+/* -*- C++ -*- */
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+/*
+ * @file   libscalable.cpp
+ * @brief  A thread-scalable replacement for malloc etc.
+ *
+ * Each thread keeps small, bounded caches of free objects of up to
+ * MaxLocalSize bytes (one per power-of-two class), used without
+ * locking. They refill in batches from, and overflow back to, one
+ * shared Kingsley (power-of-two size class) heap behind a spin lock,
+ * which also serves larger objects and carves fresh objects from 1 MB
+ * zones of pages. malloc_trim hands its cached pages back to the OS.
+ *
+ * Every object carries a size header, so any thread may free any
+ * object. An object freed on another thread joins that thread's
+ * cache, but since each cache is bounded (see ThreadCacheHeap), the
+ * excess goes back to the shared heap for every thread to reuse,
+ * rather than piling up where it was freed.
+ */
+
+#include <stdlib.h>
+
+volatile int anyThreadCreated = 1;
+
+#include "heaplayers.h"
+
+
+using namespace HL;
+
+// Objects up to this size (a power of two) are cached per thread.
+enum { MaxLocalSize = 32 * 1024 };
+
+// The source: zones of fresh pages, each object with a size header.
+// (Only the shared heap uses it, under its lock.)
+class TopHeap : public SizeHeap<ZoneHeap<SizedMmapHeap, 1048576>> {};
+
+// The shared heap.
+class CentralHeap : public KingsleyHeap<AdaptHeap<DLList, TopHeap>, TopHeap> {};
+
+// The per-thread caches are exported, so that HL::allocate (see
+// wrappers/inlinealloc.h) can use them from inline code.
+class TheCustomHeapType :
+  public ANSIWrapper<ThreadCacheHeap<CentralHeap, SpinLock, MaxLocalSize, true>> {};
+
+// One instance of each, created on first use and never destroyed
+// (malloc may still be called from atexit handlers).
+template <class Heap>
+inline static Heap * getHeap() {
+  alignas(std::max_align_t) static char buf[sizeof(Heap)];
+  static Heap * heap = new (buf) Heap;
+  return heap;
+}
+
+inline static TheCustomHeapType * getCustomHeap() {
+  return getHeap<TheCustomHeapType>();
+}
+
+#if defined(_WIN32)
+#pragma warning(disable:4273)
+#endif
+
+#include "printf.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+
+extern "C" {
+  // For use by the replacement printf routines (see
+  // https://github.com/emeryberger/printf)
+  void _putchar(char ch) { ::write(1, (void *)&ch, 1); }
+}
+#endif
+
+extern "C" {
+
+  void * xxmalloc (size_t sz) {
+    return getCustomHeap()->malloc (sz);
+  }
+
+  void * xxmalloc_zeroed (size_t sz) {
+    return getCustomHeap()->malloc_zeroed (sz);
+  }
+
+  void xxfree (void * ptr) {
+    getCustomHeap()->free (ptr);
+  }
+
+  void xxfree_sized (void * ptr, size_t) {
+    getCustomHeap()->free (ptr);
+  }
+
+  void xxfree_aligned_sized (void * ptr, size_t, size_t) {
+    getCustomHeap()->free (ptr);
+  }
+
+  void * xxmemalign (size_t alignment, size_t sz) {
+    return getCustomHeap()->memalign (alignment, sz);
+  }
+
+  size_t xxmalloc_usable_size (void * ptr) {
+    return getCustomHeap()->getSize (ptr);
+  }
+
+  int xxmalloc_try_resize (void * ptr, size_t sz) {
+    return getCustomHeap()->try_resize (ptr, sz);
+  }
+
+  size_t xxmalloc_good_size (size_t sz) {
+    return getCustomHeap()->good_size (sz);
+  }
+
+  // Flushes the calling thread's cache, then trims the shared heap.
+  size_t xxmalloc_trim (size_t pad) {
+    return HL::trim (*getCustomHeap(), pad);
+  }
+
+  // Reports the calling thread's cache and the shared heap.
+  int xxmalloc_get_stats (HL::HeapStats * stats) {
+    stats->clear();
+    HL::collect_stats (*getCustomHeap(), *stats);
+    return 1;
+  }
+
+  // Take the shared heap's lock so that fork() sees it released.
+  void xxmalloc_lock() {
+    getCustomHeap()->lock();
+  }
+
+  void xxmalloc_unlock() {
+    getCustomHeap()->unlock();
+  }
+
+}
+
+// Lets HL::allocate (see wrappers/inlinealloc.h) find each thread's cache.
+HL_EXPORT_THREAD_CACHE_SLOT
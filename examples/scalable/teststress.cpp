@@ -0,0 +1,157 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+/*
+ * A multithreaded stress test for a preloaded malloc. Each thread
+ * mixes malloc, calloc, realloc, posix_memalign and free over small
+ * and large sizes, and trades objects with the other threads, so that
+ * many are freed or resized away from where they were allocated. Every
+ * object is filled, and checked before it is next touched: calloc's
+ * memory must be zero, realloc must keep the contents, posix_memalign
+ * must align. Exits nonzero on the first failure.
+ *
+ *   g++ -std=c++14 -O2 teststress.cpp -o teststress -lpthread
+ *   LD_PRELOAD=/path/to/libscalable.so ./teststress [threads] [operations per thread]
+ *   LD_PRELOAD=/path/to/libselect.so HL_HEAP=threadcached ./teststress
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+enum { Slots = 4096, Shared = 1024 };
+
+struct Object {
+  unsigned char * ptr;
+  size_t size;
+  unsigned char fill;
+};
+
+// Objects left here by one thread are freed or resized by another.
+static std::atomic<Object *> shared[Shared];
+
+static void fail (const char * what) {
+  fprintf (stderr, "FAILED: %s\n", what);
+  abort();
+}
+
+// Checks every step'th byte (and the last).
+static void check (const Object& o, size_t step = 61) {
+  if (o.ptr == nullptr) {
+    return;
+  }
+  for (size_t i = (o.size - 1) % step; i < o.size; i += step) {
+    if (o.ptr[i] != o.fill) {
+      fail ("an object's contents changed");
+    }
+  }
+}
+
+static void run (unsigned int seed, int ops) {
+  std::vector<Object> mine (Slots, Object { nullptr, 0, 0 });
+  for (int i = 0; i < ops; i++) {
+    seed = seed * 1103515245 + 12345;
+    auto& o = mine[(seed >> 8) % Slots];
+    // Mostly small objects (as most programs use), some up to 64K.
+    const size_t sz = 1 + (seed >> 3) % ((seed & 0x10000) ? 65536 : 600);
+    check (o);
+    switch ((seed >> 20) % 6) {
+    case 0:
+      free (o.ptr);
+      o.ptr = (unsigned char *) malloc (sz);
+      break;
+    case 1:
+      free (o.ptr);
+      o.ptr = (unsigned char *) calloc (1, sz);
+      if (o.ptr != nullptr) {
+	o.size = sz;
+	o.fill = 0;
+	check (o, 1);
+      }
+      break;
+    case 2:
+      {
+	auto * p = (unsigned char *) realloc (o.ptr, sz);
+	if (p != nullptr) {
+	  o.size = (o.ptr == nullptr) ? 0 : ((o.size < sz) ? o.size : sz);
+	  o.ptr = p;
+	  check (o);
+	}
+	o.ptr = p;
+      }
+      break;
+    case 3:
+      {
+	const size_t alignment = (size_t) 16 << ((seed >> 4) % 9);
+	void * p = nullptr;
+	free (o.ptr);
+	if ((posix_memalign (&p, alignment, sz) != 0) ||
+	    (((uintptr_t) p & (alignment - 1)) != 0)) {
+	  fail ("posix_memalign");
+	}
+	o.ptr = (unsigned char *) p;
+      }
+      break;
+    case 4:
+      free (o.ptr);
+      o = Object { nullptr, 0, 0 };
+      continue;
+    case 5:
+      // Trade with whatever another thread left.
+      {
+	auto * theirs = shared[(seed >> 12) % Shared].exchange (new Object (o));
+	o = (theirs != nullptr) ? *theirs : Object { nullptr, 0, 0 };
+	delete theirs;
+      }
+      continue;
+    }
+    if (o.ptr == nullptr) {
+      fail ("out of memory");
+    }
+    o.size = sz;
+    o.fill = (unsigned char) ((seed >> 24) | 1);
+    memset (o.ptr, o.fill, sz);
+  }
+  for (auto& o : mine) {
+    free (o.ptr);
+  }
+}
+
+int main (int argc, char * argv[]) {
+  const int nthreads = (argc > 1) ? atoi (argv[1]) : 4;
+  const int ops = (argc > 2) ? atoi (argv[2]) : 500000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back (run, (unsigned int) t * 7919 + 1, ops);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (auto& s : shared) {
+    if (Object * o = s.exchange (nullptr)) {
+      check (*o);
+      free (o->ptr);
+      delete o;
+    }
+  }
+  printf ("%d threads, %d operations each: ok\n", nthreads, ops);
+  return 0;
+}
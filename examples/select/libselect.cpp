@@ -0,0 +1,114 @@
+/* -*- C++ -*- */
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+/*
+ * @file   libselect.cpp
+ * @brief  One replacement malloc library holding several allocators.
+ *
+ * The HL_HEAP environment variable picks the composition when the
+ * process starts (it cannot change later, as objects would then be
+ * freed to the wrong heap):
+ *
+ *   kingsley     power-of-two size classes, behind one lock (the default)
+ *   segregated   finer size classes up to 4K, then power-of-two,
+ *                behind one lock
+ *   threadcached bounded per-thread caches for objects up to 32K, in
+ *                front of one locked power-of-two heap (as in libscalable)
+ *
+ * e.g. LD_PRELOAD=libselect.so HL_HEAP=threadcached ./program
+ */
+
+#include <stdlib.h>
+
+volatile int anyThreadCreated = 1;
+
+#include "heaplayers.h"
+#include "wrappers/heapselect.h"
+
+using namespace HL;
+
+// kingsley
+
+class KingsleySource : public ZoneHeap<SizedMmapHeap, 65536> {};
+
+class KingsleyTopHeap : public SizeHeap<UniqueHeap<KingsleySource>> {};
+
+class KingsleyType :
+  public ANSIWrapper<LockedHeap<SpinLock, KingsleyHeap<AdaptHeap<DLList, KingsleyTopHeap>, KingsleyTopHeap>>> {};
+
+// segregated
+
+class SegregatedSource : public ZoneHeap<SizedMmapHeap, 65536> {};
+
+class SegregatedTopHeap : public SizeHeap<UniqueHeap<SegregatedSource>> {};
+
+typedef bins<SizeHeapHeader, 4096> SegregatedBins;
+
+class SegregatedType :
+  public ANSIWrapper<LockedHeap<SpinLock,
+				StrictSegHeap<SegregatedBins::NUM_BINS,
+					      SegregatedBins::getSizeClass,
+					      SegregatedBins::getClassSize,
+					      AdaptHeap<DLList, SegregatedTopHeap>,
+					      KingsleyHeap<AdaptHeap<DLList, SegregatedTopHeap>, SegregatedTopHeap>>>> {};
+
+// threadcached
+
+enum { MaxLocalSize = 32 * 1024 };
+
+class ThreadCachedTopHeap : public SizeHeap<ZoneHeap<SizedMmapHeap, 1048576>> {};
+
+class ThreadCachedCentralHeap :
+  public KingsleyHeap<AdaptHeap<DLList, ThreadCachedTopHeap>, ThreadCachedTopHeap> {};
+
+// Its per-thread caches are exported for HL::allocate (see wrappers/inlinealloc.h).
+class ThreadCachedType :
+  public ANSIWrapper<ThreadCacheHeap<ThreadCachedCentralHeap, SpinLock, MaxLocalSize, true>> {};
+
+struct HeapChoices {
+  static constexpr const char * variable = "HL_HEAP";
+  static constexpr HeapChoice choices[] = {
+    heapChoice<KingsleyType> ("kingsley"),
+    heapChoice<SegregatedType> ("segregated"),
+    heapChoice<ThreadCachedType> ("threadcached"),
+  };
+};
+
+constexpr const char * HeapChoices::variable;
+constexpr HeapChoice HeapChoices::choices[];
+
+#if defined(_WIN32)
+#pragma warning(disable:4273)
+#endif
+
+#include "printf.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+
+extern "C" {
+  // For use by the replacement printf routines (see
+  // https://github.com/emeryberger/printf)
+  void _putchar(char ch) { ::write(1, (void *)&ch, 1); }
+}
+#endif
+
+HEAP_SELECT(HeapChoices)
+
+// Lets HL::allocate (see wrappers/inlinealloc.h) find the threadcached
+// heap's per-thread caches (when it is the one selected).
+HL_EXPORT_THREAD_CACHE_SLOT
@@ -107,6 +107,19 @@ namespace HL {}
 #define HL_USE_XXREALLOC 0
 #endif
 
+/**
+ * @def HL_COMPACT_SMALL_OBJECTS
+ *
+ * Define HL_COMPACT_SMALL_OBJECTS as 1 to give requests of at most 8
+ * bytes their own 8-byte size class (in ANSIWrapper and the generic
+ * bin tables) instead of rounding them up to 16 bytes. Objects that
+ * small cannot need more than 8-byte alignment.
+ */
+
+#if !defined(HL_COMPACT_SMALL_OBJECTS)
+#define HL_COMPACT_SMALL_OBJECTS 0
+#endif
+
 #include "utility/all.h"
 #include "heaps/all.h"
 #include "locks/all.h"
@@ -21,6 +21,8 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include "utility/clearbudget.h"
+#include "utility/zeromemory.h"
 #include "utility/cpp23compat.h"
 
 /**
@@ -37,6 +39,11 @@ namespace HL {
 
     enum { Alignment = SuperHeap::Alignment };
 
+    // Freed objects are recycled here, whatever the superheap does
+    // (so they are not known to be zero).
+    enum { FreeIsNoop = 0 };
+    enum { ZeroMemory = 0 };
+
     /// Allocate an object (remove from the dictionary).
     inline void * malloc (const size_t) {
       void * ptr = (Entry *) dict.get();
@@ -46,6 +53,15 @@ namespace HL {
       return ptr;
     }
 
+    /// Allocate a zero-filled object.
+    inline void * malloc_zeroed (const size_t sz) {
+      void * ptr = malloc (sz);
+      if (ptr) {
+        zero_fill (ptr, sz, page_backed<SuperHeap>::value);
+      }
+      return ptr;
+    }
+
     /// Deallocate the object (return to the dictionary).
     inline void free (void * ptr) {
       if (ptr) {
@@ -66,14 +82,37 @@ namespace HL {
 
     /// Clear the dictionary.
     inline void clear (void) {
-      Entry * ptr;
-      while ((ptr = (Entry *) dict.get()) != NULL) {
-        SuperHeap::free (ptr);
+      if (!free_is_noop<SuperHeap>::value) {
+        Entry * ptr;
+        while ((ptr = (Entry *) dict.get()) != NULL) {
+          SuperHeap::free (ptr);
+        }
       }
       dict.clear();
       SuperHeap::clear();
     }
 
+    /// Clear at most a budget's worth of the dictionary, then the superheap.
+    inline bool clear_step (ClearBudget& budget) {
+      if (!free_is_noop<SuperHeap>::value) {
+        Entry * ptr;
+        while ((ptr = (Entry *) dict.get()) != NULL) {
+          const size_t sz = SuperHeap::getSize (ptr);
+          SuperHeap::free (ptr);
+          if (!budget.charge (sz)) {
+            return false;
+          }
+        }
+      }
+      dict.clear();
+      return HL::clear_step (static_cast<SuperHeap&>(*this), budget);
+    }
+
+    /// Forget every object in the dictionary without touching them, in O(1).
+    inline void discard (void) {
+      dict.clear();
+    }
+
 
   private:
 
@@ -1,4 +1,5 @@
 #include "adaptheap.h"
+#include "atomicfreelistheap.h"
 #include "boundedfreelistheap.h"
 #include "chunkheap.h"
 #include "coalesceheap.h"
@@ -0,0 +1,120 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_ATOMICFREELISTHEAP_H
+#define HL_ATOMICFREELISTHEAP_H
+
+/**
+ * @class AtomicFreelistHeap
+ * @brief FreelistHeap for many threads at once: a lock-free free list.
+ * @warning This is for one "size class" only.
+ *
+ * malloc and free are a pop and a push on an AtomicFreeList, so a
+ * size class can be shared by every thread without a LockedHeap. Only
+ * a miss reaches SuperHeap, which must therefore be thread-safe
+ * itself (a LockedHeap over a bump allocator, say); since that is the
+ * rare path, its lock sees little contention.
+ *
+ * freeChain and takeAll move many objects at once, so that per-thread
+ * caches can refill from, and flush to, a shared class in one CAS.
+ *
+ * Objects on the list may be read by a racing pop after being taken,
+ * so clear and trim, which hand objects back to SuperHeap, must run
+ * only while no other thread is using this heap.
+ */
+
+#include "utility/atomicfreelist.h"
+#include "utility/cpp23compat.h"
+#include "utility/trim.h"
+#include "utility/zeromemory.h"
+
+namespace HL {
+
+  template <class SuperHeap>
+  class AtomicFreelistHeap : public SuperHeap {
+  public:
+
+    enum { FreeIsNoop = 0 };
+    enum { ZeroMemory = 0 };
+
+    inline void * malloc (size_t sz) {
+      void * ptr = _freelist.pop();
+      if (HL_EXPECT_FALSE(ptr == nullptr)) HL_UNLIKELY {
+	ptr = SuperHeap::malloc (sz);
+      }
+      return ptr;
+    }
+
+    inline void * malloc_zeroed (size_t sz) {
+      void * ptr = _freelist.pop();
+      if (ptr) {
+	zero_fill (ptr, sz, page_backed<SuperHeap>::value);
+	return ptr;
+      }
+      return HL::malloc_zeroed (static_cast<SuperHeap&>(*this), sz);
+    }
+
+    inline void free (void * ptr) {
+      if (HL_EXPECT_FALSE(!ptr)) HL_UNLIKELY {
+	return;
+      }
+      _freelist.push (ptr);
+    }
+
+    /// Free a chain of objects, first to last, linked with
+    /// AtomicFreeList::setNext.
+    inline void freeChain (void * first, void * last) {
+      _freelist.pushChain (first, last);
+    }
+
+    /// Take every free object, as a chain (follow it with
+    /// AtomicFreeList::getNext), or nullptr.
+    inline void * takeAll() {
+      return _freelist.popAll();
+    }
+
+    /// Hand every free object back to the superheap (while no other
+    /// thread uses this heap).
+    inline void clear() {
+      void * ptr = _freelist.popAll();
+      if (free_is_noop<SuperHeap>::value) {
+	return;
+      }
+      while (ptr) {
+	void * next = AtomicFreeList::getNext (ptr);
+	SuperHeap::free (ptr);
+	ptr = next;
+      }
+    }
+
+    /// As clear (if that releases anything), then trim the superheap.
+    inline size_t trim (size_t pad) {
+      if (!free_is_noop<SuperHeap>::value) {
+	clear();
+      }
+      return HL::trim (static_cast<SuperHeap&>(*this), pad);
+    }
+
+  private:
+
+    AtomicFreeList _freelist;
+
+  };
+
+}
+
+#endif
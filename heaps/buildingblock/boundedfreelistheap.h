@@ -8,13 +8,20 @@
 #include <cassert>
 #include <cstdlib>
 #include "utility/freesllist.h"
+#include "utility/tunables.h"
 
 template <int numObjects, class Super>
 class BoundedFreeListHeap : public Super {
 public:
 
+  // Freed objects are recycled here, whatever the superheap does
+  // (so they are not known to be zero).
+  enum { FreeIsNoop = 0 };
+  enum { ZeroMemory = 0 };
+
   BoundedFreeListHeap()
-    : nObjects (0)
+    : nObjects (0),
+      limit (numObjects)
   {}
 
   ~BoundedFreeListHeap()
@@ -34,12 +41,15 @@ public:
   }
 
   inline void free (void * ptr) {
-    if (nObjects < numObjects) {
+    if (nObjects < limit) {
       // Add this object to the free list.
       _freelist.insert(ptr);
       nObjects++;
     } else {
+      // Full: pick up any change to the bound, then make room.
+      limit = (int) _bound.get (numObjects);
       clear();
+      Super::free(ptr);
     }
   }
 
@@ -48,13 +58,18 @@ public:
     void * ptr;
     while ((ptr = _freelist.get()) != nullptr) {
       Super::free(ptr);
-      assert(nObjects-- > 0);
+      assert(nObjects > 0);
+      nObjects--;
     }
   }
 
 private:
 
   int nObjects;
+
+  /// The bound in effect (numObjects unless tuned), re-read when full.
+  int limit;
+  HL::TunableCache<HL::Tunables::FreelistBound> _bound;
   FreeSLList _freelist;
 };
 
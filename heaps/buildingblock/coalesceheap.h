@@ -35,6 +35,11 @@ namespace HL {
   class CoalesceHeap : public super {
   public:
 
+    // Freed objects are recycled here, whatever the superheap does
+    // (so they are not known to be zero).
+    enum { FreeIsNoop = 0 };
+    enum { ZeroMemory = 0 };
+
     inline void * malloc (const size_t sz)
     {
       void * ptr = super::malloc (sz);
@@ -81,6 +86,32 @@ namespace HL {
       super::free (ptr);
     }
 
+    /// Resize in place: shrink by splitting off the tail, or grow by
+    /// absorbing the next object if it is free and big enough.
+    inline bool try_resize (void * ptr, const size_t sz)
+    {
+      if (sz > super::getSize(ptr)) {
+	void * next = super::getNext (ptr);
+	if ((super::getPrev(next) != ptr) || !super::isFree(next)) {
+	  return false;
+	}
+	const size_t combinedSize =
+	  super::getSize(ptr) + sizeof(typename super::Header) + super::getSize(next);
+	if (combinedSize < sz) {
+	  return false;
+	}
+	super::remove (next);
+	coalesce (ptr, next);
+	super::markInUse (ptr);
+      }
+      // Give back whatever we don't need (coalescing it with a free successor).
+      void * splitPiece = split (ptr, sz);
+      if (splitPiece != NULL) {
+	free (splitPiece);
+      }
+      return true;
+    }
+
   private:
 
 
@@ -92,7 +123,7 @@ namespace HL {
       // Now coalesce.
       size_t newSize = ((size_t) second - (size_t) first) + super::getSize(second);
       super::setSize (first, newSize);
-      setPrevSize (super::getNext(first), newSize);
+      super::setPrevSize (super::getNext(first), newSize);
     }
 
     // Split an object if it is big enough.
@@ -29,6 +29,9 @@
 
 #include <assert.h>
 #include "utility/freesllist.h"
+#include "utility/clearbudget.h"
+#include "utility/trim.h"
+#include "utility/zeromemory.h"
 #include "utility/cpp23compat.h"
 
 namespace HL {
@@ -37,17 +40,33 @@ namespace HL {
   class FreelistHeap : public SuperHeap {
   public:
 
+    // Freed objects are recycled here, whatever the superheap does
+    // (so they are not known to be zero).
+    enum { FreeIsNoop = 0 };
+    enum { ZeroMemory = 0 };
+
     inline void * malloc (size_t sz) {
       // Check the free list first.
       void * ptr = _freelist.get();
       // If it's empty, get more memory;
       // otherwise, advance the free list pointer.
       if (!ptr) {
+        _missSize = sz;
         ptr = SuperHeap::malloc (sz);
       }
       return ptr;
     }
 
+    inline void * malloc_zeroed (size_t sz) {
+      void * ptr = _freelist.get();
+      if (ptr) {
+        zero_fill (ptr, sz, page_backed<SuperHeap>::value);
+        return ptr;
+      }
+      _missSize = sz;
+      return HL::malloc_zeroed (static_cast<SuperHeap&>(*this), sz);
+    }
+
     inline void free (void * ptr) {
       if (HL_EXPECT_FALSE(!ptr)) HL_UNLIKELY {
         return;
@@ -56,16 +75,61 @@ namespace HL {
     }
 
     inline void clear (void) {
+      if (free_is_noop<SuperHeap>::value) {
+        // Handing objects back would not release anything.
+        discard();
+        return;
+      }
+      void * ptr;
+      while ((ptr = _freelist.get())) {
+        SuperHeap::free (ptr);
+      }
+    }
+
+    /// Return at most a budget's worth of objects to the superheap.
+    /// Each is charged at its size, if the superheap can tell us, or
+    /// else at the size last requested from the superheap.
+    inline bool clear_step (ClearBudget& budget) {
+      if (free_is_noop<SuperHeap>::value) {
+        discard();
+        return true;
+      }
       void * ptr;
       while ((ptr = _freelist.get())) {
+        const auto sz = charge_size (static_cast<SuperHeap&>(*this), ptr, _missSize);
         SuperHeap::free (ptr);
+        if (!budget.charge (sz)) {
+          break;
+        }
+      }
+      return _freelist.isEmpty();
+    }
+
+    /// Hand the freed objects back to the superheap (if that releases
+    /// anything), then trim it. We do not know the objects' sizes, so
+    /// only what the superheap releases in turn is counted.
+    inline size_t trim (size_t pad) {
+      if (!free_is_noop<SuperHeap>::value) {
+        void * ptr;
+        while ((ptr = _freelist.get())) {
+          SuperHeap::free (ptr);
+        }
       }
+      return HL::trim (static_cast<SuperHeap&>(*this), pad);
+    }
+
+    /// Forget every freed object without touching them, in O(1).
+    inline void discard (void) {
+      _freelist.clear();
     }
 
   private:
 
     FreeSLList _freelist;
 
+    /// The size last requested from the superheap (for clear_step).
+    size_t _missSize = 0;
+
   };
 
 }
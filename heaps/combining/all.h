@@ -1,4 +1,5 @@
 #include "hybridheap.h"
+#include "packedsegheap.h"
 #include "segheap.h"
 #include "strictsegheap.h"
 #include "tryheap.h"
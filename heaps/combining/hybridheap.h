@@ -21,6 +21,12 @@
 #include <assert.h>
 
 #include "heaplayers.h"
+#include "utility/goodsize.h"
+#include "utility/heapstats.h"
+#include "utility/memalign.h"
+#include "utility/trim.h"
+#include "utility/tryresize.h"
+#include "utility/zeromemory.h"
 
 /**
  * @class HybridHeap
@@ -40,6 +46,7 @@ namespace HL {
     }
 
     enum { Alignment = gcd<(int) SmallHeap::Alignment, (int) BigHeap::Alignment>::value };
+    enum { ZeroMemory = zero_memory<SmallHeap>::value && zero_memory<BigHeap>::value };
 
     MALLOC_FUNCTION INLINE void * malloc (size_t sz) {
       void * ptr;
@@ -56,6 +63,22 @@ namespace HL {
       return ptr;
     }
 
+    inline void * malloc_zeroed (size_t sz) {
+      if (sz <= BigSize) {
+        return HL::malloc_zeroed (static_cast<SmallHeap&>(*this), sz);
+      }
+      return HL::malloc_zeroed (bm, sz);
+    }
+
+    /// Aligned allocation, from whichever heap the size belongs to
+    /// (free tells them apart by size alone, so it must not change).
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (sz <= BigSize) {
+        return HL::memalign (static_cast<SmallHeap&>(*this), alignment, sz);
+      }
+      return HL::memalign (bm, alignment, sz);
+    }
+
     inline void free (void * ptr) {
       if (SmallHeap::getSize(ptr) <= BigSize) {
         SmallHeap::free (ptr);
@@ -64,11 +87,35 @@ namespace HL {
       }
     }
 
+    inline size_t good_size (size_t sz) {
+      if (sz <= BigSize) {
+        return HL::good_size (static_cast<SmallHeap&>(*this), sz);
+      }
+      return HL::good_size (bm, sz);
+    }
+
+    /// Resize in place, as long as the object stays on its side of BigSize.
+    inline bool try_resize (void * ptr, size_t sz) {
+      if (SmallHeap::getSize(ptr) <= BigSize) {
+        return (sz <= BigSize) && HL::try_resize (static_cast<SmallHeap&>(*this), ptr, sz);
+      }
+      return (sz > BigSize) && HL::try_resize (bm, ptr, sz);
+    }
+
+    inline size_t trim (size_t pad) {
+      return HL::trim (static_cast<SmallHeap&>(*this), pad) + HL::trim (bm, pad);
+    }
+
     inline void clear (void) {
       bm.clear();
       SmallHeap::clear();
     }
 
+    void collect_stats (HeapStats& stats) {
+      HL::collect_stats (static_cast<SmallHeap&>(*this), stats);
+      HL::collect_stats (bm, stats);
+    }
+
 
   private:
 
@@ -0,0 +1,397 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+/**
+ * @file packedsegheap.h
+ * @brief Definition of PackedSegHeap.
+ */
+
+#ifndef HL_PACKEDSEGHEAP_H
+#define HL_PACKEDSEGHEAP_H
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "utility/clearbudget.h"
+#include "utility/cpp23compat.h"
+#include "utility/goodsize.h"
+#include "utility/heapstats.h"
+#include "utility/memalign.h"
+#include "utility/trim.h"
+#include "utility/tryresize.h"
+#include "utility/zeromemory.h"
+
+/**
+ * @class PackedSegHeap
+ * @brief A strict segregated-fits heap with cache-conscious bin layout.
+ * @author Emery Berger
+ *
+ * Behaves like a StrictSegHeap whose per-class heaps are freelists,
+ * but instead of an array of LittleHeap objects (each with its own
+ * bookkeeping), it keeps the freelist heads in one packed array (a
+ * struct-of-arrays layout) at the start of the object, followed by
+ * the class-to-slot table. Everything else is kept in a separate,
+ * cold part of the object that malloc and free do not touch.
+ *
+ * Slots are ordered by observed popularity: one malloc in every
+ * SamplePeriod is counted against its size class (a countdown in the
+ * cold part decides which), and every ReorderInterval mallocs (or on
+ * an explicit call to reorder()) the most frequently sampled classes
+ * are moved to the front, so the heads of the hot classes share the
+ * first cache line or two. Hits and refills count alike.
+ *
+ * @param NumBins The number of bins (size classes).
+ * @param size2class Function to compute size class from size.
+ * @param class2size Function to compute the largest size for a given size class.
+ * @param BigHeap The source of all objects, also used for "big" objects.
+ * @param ReorderInterval The number of mallocs between automatic reorderings (0 = never).
+ * @sa StrictSegHeap
+ */
+
+namespace HL {
+
+  template <int NumBins,
+	    int (*size2class) (const size_t),
+	    size_t (*class2size) (const int),
+	    class BigHeap,
+	    unsigned long ReorderInterval = 4096>
+  class PackedSegHeap {
+  public:
+
+    enum { Alignment = BigHeap::Alignment };
+
+    // Freed objects are recycled in the bins (so they are not known to be zero).
+    enum { FreeIsNoop = 0 };
+    enum { PageBacked = page_backed<BigHeap>::value };
+
+    /// One malloc in this many is sampled (a prime, so that regular
+    /// allocation patterns do not always sample the same class).
+    enum { SamplePeriod = 61 };
+
+    static constexpr size_t num_size_classes = NumBins;
+    int get_size_class(const size_t sz) const { return size2class(sz); }
+    size_t get_class_size(int i) const { return class2size(i); }
+
+    PackedSegHeap()
+    {
+      static_assert(NumBins > 0 && NumBins <= 255, "Slots must fit in a byte.");
+      static_assert(sizeof(FreeObject) <= sizeof(double), "Objects must be able to hold a pointer.");
+      _hot.maxObjectSize = class2size(NumBins - 1);
+      for (int i = 0; i < NumBins; i++) {
+	_hot.head[i] = nullptr;
+	_hot.slot[i] = (unsigned char) i;
+	_cold.samples[i] = 0;
+      }
+      _cold.mallocsUntilSample = SamplePeriod;
+      _cold.samplesUntilReorder = samplesPerReorder();
+      _cold.clearBin = 0;
+    }
+
+    inline void * malloc (const size_t sz) {
+      if (HL_EXPECT_TRUE(sz <= _hot.maxObjectSize)) HL_LIKELY {
+	const auto sizeClass = size2class(sz);
+	assert (sizeClass >= 0);
+	assert (sizeClass < NumBins);
+	HL_ASSUME(sizeClass >= 0);
+	HL_ASSUME(sizeClass < NumBins);
+	countMalloc (sizeClass);
+	auto& head = _hot.head[_hot.slot[sizeClass]];
+	auto * obj = head;
+	if (HL_EXPECT_TRUE(obj != nullptr)) HL_LIKELY {
+	  head = obj->next;
+	  return obj;
+	}
+	return bigheap.malloc (class2size(sizeClass));
+      }
+      return bigheap.malloc (sz);
+    }
+
+    /// The size malloc would really allocate (the class size for small objects).
+    inline size_t good_size (const size_t sz) {
+      if (HL_EXPECT_TRUE(sz <= _hot.maxObjectSize)) HL_LIKELY {
+	return class2size(size2class(sz));
+      }
+      return HL::good_size (bigheap, sz);
+    }
+
+    inline void * malloc_zeroed (const size_t sz) {
+      if (HL_EXPECT_TRUE(sz <= _hot.maxObjectSize)) HL_LIKELY {
+	const auto sizeClass = size2class(sz);
+	countMalloc (sizeClass);
+	auto * obj = pop (sizeClass);
+	if (obj != nullptr) {
+	  zero_fill (obj, sz, PageBacked);
+	  return obj;
+	}
+	return HL::malloc_zeroed (bigheap, class2size(sizeClass));
+      }
+      return HL::malloc_zeroed (bigheap, sz);
+    }
+
+    /// Aligned allocation: reuse the head of the class's list if it is
+    /// suitably aligned, otherwise get a new object of the class from
+    /// the big heap (it joins the class's list when freed).
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (alignment <= (size_t) Alignment) {
+	return malloc (sz);
+      }
+      if (HL_EXPECT_TRUE(sz <= _hot.maxObjectSize)) HL_LIKELY {
+	const auto sizeClass = size2class(sz);
+	countMalloc (sizeClass);
+	auto& head = _hot.head[_hot.slot[sizeClass]];
+	if ((head != nullptr) && (((uintptr_t) head & (alignment - 1)) == 0)) {
+	  return pop (sizeClass);
+	}
+	return HL::memalign (bigheap, alignment, class2size(sizeClass));
+      }
+      return HL::memalign (bigheap, alignment, sz);
+    }
+
+    inline void free (void * ptr) {
+      free (ptr, bigheap.getSize (ptr));
+    }
+
+    inline void free (void * ptr, size_t objectSize) {
+      if (HL_EXPECT_FALSE(objectSize > _hot.maxObjectSize)) HL_UNLIKELY {
+	bigheap.free (ptr);
+	return;
+      }
+      auto objectSizeClass = size2class(objectSize);
+      assert (objectSizeClass >= 0);
+      assert (objectSizeClass < NumBins);
+      HL_ASSUME(objectSizeClass >= 0);
+      HL_ASSUME(objectSizeClass < NumBins);
+      // As in StrictSegHeap, only put an object in a bin whose
+      // objects are no bigger than it is.
+      while ((objectSizeClass > 0) &&
+	     (class2size(objectSizeClass) > objectSize)) {
+	objectSizeClass--;
+      }
+      if (class2size(objectSizeClass) >= objectSize) {
+	auto& head = _hot.head[_hot.slot[objectSizeClass]];
+	auto * obj = HL::start_lifetime_as<FreeObject>(ptr);
+	obj->next = head;
+	head = obj;
+      }
+    }
+
+    inline size_t getSize (void * ptr) {
+      return bigheap.getSize (ptr);
+    }
+
+    /// Resize in place if the new size would land in the object's
+    /// own size class; big objects are resized by the big heap.
+    inline bool try_resize (void * ptr, size_t newSize) {
+      const auto objectSize = bigheap.getSize (ptr);
+      if (HL_EXPECT_FALSE(objectSize > _hot.maxObjectSize)) HL_UNLIKELY {
+	if (newSize <= _hot.maxObjectSize) {
+	  return false;
+	}
+	if (newSize <= objectSize) {
+	  return true;
+	}
+	return HL::try_resize (bigheap, ptr, newSize);
+      }
+      return (newSize <= objectSize) && (size2class(newSize) == size2class(objectSize));
+    }
+
+    /// Return every cached object to the big heap. If the big heap's
+    /// free would not release anything, forget them and clear the big
+    /// heap instead, which releases all of its memory (live objects
+    /// included) at once.
+    void clear() {
+      for (int i = 0; i < NumBins; i++) {
+	if (!free_is_noop<BigHeap>::value) {
+	  FreeObject * obj;
+	  while ((obj = pop (i)) != nullptr) {
+	    bigheap.free (obj);
+	  }
+	}
+	_hot.head[_hot.slot[i]] = nullptr;
+      }
+      clearBigHeap (free_is_noop<BigHeap>());
+      _cold.clearBin = 0;
+    }
+
+    bool clear_step (ClearBudget& budget) {
+      if (free_is_noop<BigHeap>::value) {
+	// Forget the bins at once, then release the big heap (a step
+	// at a time, if it can).
+	if (_cold.clearBin < NumBins) {
+	  for (int s = 0; s < NumBins; s++) {
+	    _hot.head[s] = nullptr;
+	  }
+	  _cold.clearBin = NumBins;
+	}
+	if (!clearBigHeap (budget, free_is_noop<BigHeap>())) {
+	  return false;
+	}
+      }
+      while (_cold.clearBin < NumBins) {
+	FreeObject * obj;
+	while ((obj = pop (_cold.clearBin)) != nullptr) {
+	  bigheap.free (obj);
+	  if (!budget.charge (class2size(_cold.clearBin))) {
+	    return false;
+	  }
+	}
+	_cold.clearBin++;
+      }
+      _cold.clearBin = 0;
+      return true;
+    }
+
+    /// Hand every cached object back to the big heap, then trim it;
+    /// if that would not release anything, discard the pages inside
+    /// the cached objects instead.
+    size_t trim (size_t pad) {
+      size_t released = 0;
+      for (int i = 0; i < NumBins; i++) {
+	if (!free_is_noop<BigHeap>::value) {
+	  FreeObject * obj;
+	  while ((obj = pop (i)) != nullptr) {
+	    bigheap.free (obj);
+	  }
+	} else if (page_backed<BigHeap>::value && (class2size(i) >= CPUInfo::PageSize)) {
+	  for (auto * obj = _hot.head[_hot.slot[i]]; obj != nullptr; obj = obj->next) {
+	    released += release_pages (obj, bigheap.getSize (obj));
+	  }
+	}
+      }
+      return released + HL::trim (bigheap, pad);
+    }
+
+    /// Report the objects cached in each class, then the big heap.
+    void collect_stats (HeapStats& stats) {
+      for (int i = 0; i < NumBins; i++) {
+	size_t objects = 0;
+	size_t bytes = 0;
+	for (auto * obj = _hot.head[_hot.slot[i]]; obj != nullptr; obj = obj->next) {
+	  objects++;
+	  bytes += bigheap.getSize (obj);
+	}
+	stats.addFree (i, class2size(i), objects, bytes);
+      }
+      HL::collect_stats (bigheap, stats);
+    }
+
+    /// Move the most frequently sampled classes to the front slots.
+    NO_INLINE void reorder() {
+      // Rank classes by sample count (a simple insertion sort: there
+      // are few bins, and this is rare).
+      unsigned char order[NumBins];
+      for (int i = 0; i < NumBins; i++) {
+	int j = i;
+	while ((j > 0) && (_cold.samples[order[j-1]] < _cold.samples[i])) {
+	  order[j] = order[j-1];
+	  j--;
+	}
+	order[j] = (unsigned char) i;
+      }
+      // Rebuild the slot table, carrying each class's list along.
+      FreeObject * heads[NumBins];
+      for (int i = 0; i < NumBins; i++) {
+	heads[i] = _hot.head[_hot.slot[i]];
+      }
+      for (int s = 0; s < NumBins; s++) {
+	const auto c = order[s];
+	_hot.slot[c] = (unsigned char) s;
+	_hot.head[s] = heads[c];
+	// Decay the counts so the order can follow phase changes.
+	_cold.samples[c] /= 2;
+      }
+      _cold.samplesUntilReorder = samplesPerReorder();
+    }
+
+  private:
+
+    class FreeObject {
+    public:
+      FreeObject * next;
+    };
+
+    inline FreeObject * pop (int sizeClass) {
+      auto& head = _hot.head[_hot.slot[sizeClass]];
+      auto * obj = head;
+      if (obj != nullptr) {
+	head = obj->next;
+      }
+      return obj;
+    }
+
+    // Only a big heap whose free is a no-op is cleared (wholesale)
+    // along with the bins.
+    void clearBigHeap (std::true_type) {
+      bigheap.clear();
+    }
+
+    void clearBigHeap (std::false_type) {}
+
+    bool clearBigHeap (ClearBudget& budget, std::true_type) {
+      return HL::clear_step (bigheap, budget);
+    }
+
+    bool clearBigHeap (ClearBudget&, std::false_type) {
+      return true;
+    }
+
+    static constexpr unsigned long samplesPerReorder() {
+      return (ReorderInterval > SamplePeriod) ? (ReorderInterval / SamplePeriod) : 1;
+    }
+
+    /// Count down to the next sample; every SamplePeriod-th malloc is
+    /// charged to its class.
+    inline void countMalloc (int sizeClass) {
+      if (HL_EXPECT_FALSE(--_cold.mallocsUntilSample == 0)) HL_UNLIKELY {
+	sample (sizeClass);
+      }
+    }
+
+    NO_INLINE void sample (int sizeClass) {
+      _cold.mallocsUntilSample = SamplePeriod;
+      _cold.samples[sizeClass]++;
+      if ((ReorderInterval > 0) && (--_cold.samplesUntilReorder == 0)) {
+	reorder();
+      }
+    }
+
+    /// The state used by malloc and free, packed together: freelist
+    /// heads by slot (hottest first), then the class-to-slot table.
+    struct alignas(64) HotState {
+      FreeObject * head[NumBins];
+      unsigned char slot[NumBins];
+      size_t maxObjectSize;
+    };
+
+    /// Bookkeeping kept apart from the bins (malloc only decrements
+    /// the sample countdown).
+    struct alignas(64) ColdState {
+      unsigned int mallocsUntilSample;
+      unsigned long samples[NumBins];
+      unsigned long samplesUntilReorder;
+      int clearBin;
+    };
+
+    HotState _hot;
+    ColdState _cold;
+
+    BigHeap bigheap;
+  };
+
+}
+
+#endif
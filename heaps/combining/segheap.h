@@ -50,7 +50,12 @@
 #include <assert.h>
 
 #include "utility/gcd.h"
+#include "utility/clearbudget.h"
 #include "utility/cpp23compat.h"
+#include "utility/goodsize.h"
+#include "utility/heapstats.h"
+#include "utility/trim.h"
+#include "utility/zeromemory.h"
 
 namespace HL {
 
@@ -64,13 +69,18 @@ namespace HL {
 
     enum { Alignment = gcd<LittleHeap::Alignment, BigHeap::Alignment>::VALUE };
 
+    // Freed objects are recycled in the bins (so they are not known to be zero).
+    enum { FreeIsNoop = 0 };
+    enum { ZeroMemory = 0 };
+
     static constexpr size_t num_size_classes = NumBins;
     int get_size_class(const size_t sz) const { return getSizeClass(sz); }
     size_t get_class_size(int i) const { return getClassMaxSize(i); }
     
     inline SegHeap()
       : _memoryHeld (0),
-	_maxObjectSize (getClassMaxSize(NumBins - 1))
+	_maxObjectSize (getClassMaxSize(NumBins - 1)),
+	_clearBin (0)
     {
       for (int i = 0; i < NUM_ULONGS; i++) {
         binmap[i] = 0;
@@ -85,6 +95,15 @@ namespace HL {
       return LittleHeap::getSize (ptr);
     }
 
+    /// Small requests are worth rounding up to their class's size,
+    /// which is what the bins recycle.
+    inline size_t good_size (const size_t sz) {
+      if (HL_EXPECT_FALSE(sz > _maxObjectSize)) HL_UNLIKELY {
+        return HL::good_size (bigheap, sz);
+      }
+      return getClassMaxSize (getSizeClass (sz));
+    }
+
     inline void * malloc (const size_t sz) {
       void * ptr = nullptr;
       if (HL_EXPECT_FALSE(sz > _maxObjectSize)) HL_UNLIKELY {
@@ -185,10 +204,93 @@ namespace HL {
       }
       bigheap.clear();
       _memoryHeld = 0;
+      _clearBin = 0;
+    }
+
+    /// Clear one bin at a time (then the big heap) until the budget
+    /// runs out; returns true once everything has been cleared.
+    bool clear_step (ClearBudget& budget) {
+      while (_clearBin < NumBins) {
+        if (!HL::clear_step (myLittleHeap[_clearBin], budget)) {
+          return false;
+        }
+        unmark_bin (_clearBin);
+        _clearBin++;
+        if (budget.exhausted()) {
+          return false;
+        }
+      }
+      if (!HL::clear_step (bigheap, budget)) {
+        return false;
+      }
+      _memoryHeld = 0;
+      _clearBin = 0;
+      return true;
+    }
+
+    /**
+     * Hand every cached object back to the big heap, then trim it.
+     * If the big heap's free would not release anything, the objects
+     * stay cached instead, and the whole pages inside the big ones
+     * are discarded (when the memory is page-backed). Only discarded
+     * pages and what the big heap's trim releases are counted.
+     */
+    size_t trim (size_t pad) {
+      size_t released = 0;
+      for (auto i = 0; i < NumBins; i++) {
+        if (!free_is_noop<BigHeap>::value) {
+          void * ptr;
+          while ((ptr = myLittleHeap[i].malloc (getClassMaxSize(i))) != NULL) {
+            bigheap.free (ptr);
+          }
+          unmark_bin (i);
+        } else if (page_backed<BigHeap>::value && (getClassMaxSize(i) >= CPUInfo::PageSize)) {
+          forEachFree (i, [&](void * ptr) {
+            released += release_pages (ptr, getSize (ptr));
+          });
+        }
+      }
+      if (!free_is_noop<BigHeap>::value) {
+        _memoryHeld = 0;
+      }
+      return released + HL::trim (bigheap, pad);
+    }
+
+    /// Report the objects cached in each bin, then the big heap.
+    void collect_stats (HeapStats& stats) {
+      for (auto i = 0; i < NumBins; i++) {
+        size_t objects = 0;
+        size_t bytes = 0;
+        forEachFree (i, [&](void * ptr) {
+          objects++;
+          bytes += getSize (ptr);
+        });
+        stats.addFree (i, getClassMaxSize(i), objects, bytes);
+      }
+      HL::collect_stats (bigheap, stats);
     }
 
   private:
 
+    /// Visit every object cached in bin i, leaving the bin as it was.
+    /// (The little heaps only offer malloc and free, so the objects
+    /// are taken out, chained through their first word, and put back.)
+    template <class Func>
+    void forEachFree (int i, Func f) {
+      void * chain = nullptr;
+      void * ptr;
+      while ((ptr = myLittleHeap[i].malloc (getClassMaxSize(i))) != NULL) {
+        f (ptr);
+        *((void **) ptr) = chain;
+        chain = ptr;
+      }
+      while (chain != nullptr) {
+        ptr = chain;
+        chain = *((void **) ptr);
+        myLittleHeap[i].free (ptr);
+      }
+    }
+
     enum { BITS_PER_ULONG = sizeof(unsigned long) * 8 };
     enum { SHIFTS_PER_ULONG = (BITS_PER_ULONG == 32) ? 5 : 6 };
     enum { MAX_BITS = (NumBins + BITS_PER_ULONG - 1) & ~(BITS_PER_ULONG - 1) };
@@ -232,6 +334,9 @@ namespace HL {
 
     const size_t _maxObjectSize;
 
+    /// The next bin for clear_step() to visit.
+    int _clearBin;
+
     // The little heaps.
     LittleHeap myLittleHeap[NumBins];
 
@@ -24,6 +24,10 @@
 #define HL_STRICTSEGHEAP_H
 
 #include "segheap.h"
+#include "utility/goodsize.h"
+#include "utility/memalign.h"
+#include "utility/tryresize.h"
+#include "utility/zeromemory.h"
 
 /**
  * @class StrictSegHeap
@@ -63,18 +67,58 @@ namespace HL {
     int get_size_class(const size_t sz) const { return size2class(sz); }
     size_t get_class_size(int i) const { return class2size(i); }
     
+    /// Return every cached object to the big heap. If the big heap's
+    /// free would not release anything, drop the cached objects and
+    /// clear the big heap instead, which releases all of its memory
+    /// (live objects included) at once.
     void clear () {
-      for (auto i = 0; i < NumBins; i++) {
+      drainBins (free_is_noop<BigHeap>());
+      for (auto j = 0; j < SuperHeap::NUM_ULONGS; j++) {
+        SuperHeap::binmap[j] = 0;
+      }
+      SuperHeap::_memoryHeld = 0;
+      SuperHeap::_clearBin = 0;
+    }
+
+    /// Like clear(), but return at most a budget's worth of objects
+    /// (or, over a big heap whose free is a no-op, of the big heap's
+    /// spans) per call; returns true once everything is clear.
+    bool clear_step (ClearBudget& budget) {
+      if (free_is_noop<BigHeap>::value) {
+        // Drop the bins at once, then release the big heap (a step at
+        // a time, if it can).
+        if (SuperHeap::_clearBin < NumBins) {
+          for (auto i = 0; i < NumBins; i++) {
+            SuperHeap::myLittleHeap[i].discard();
+          }
+          for (auto j = 0; j < SuperHeap::NUM_ULONGS; j++) {
+            SuperHeap::binmap[j] = 0;
+          }
+          SuperHeap::_memoryHeld = 0;
+          SuperHeap::_clearBin = NumBins;
+        }
+        if (!clearBigHeap (budget, free_is_noop<BigHeap>())) {
+          return false;
+        }
+      }
+      while (SuperHeap::_clearBin < NumBins) {
+        const auto i = SuperHeap::_clearBin;
         const size_t sz = class2size(i);
         void * ptr;
         while ((ptr = SuperHeap::myLittleHeap[i].malloc (sz)) != NULL) {
           SuperHeap::bigheap.free (ptr);
+          if (!budget.charge (sz)) {
+            return false;
+          }
         }
+        SuperHeap::_clearBin++;
       }
       for (auto j = 0; j < SuperHeap::NUM_ULONGS; j++) {
         SuperHeap::binmap[j] = 0;
       }
       SuperHeap::_memoryHeld = 0;
+      SuperHeap::_clearBin = 0;
+      return true;
     }
 
     /**
@@ -103,6 +147,63 @@ namespace HL {
       return ptr;
     }
 
+    /// The size malloc would really allocate: the class size (which big
+    /// objects are rounded to as well, before the big heap rounds them).
+    inline size_t good_size (const size_t sz) {
+      const auto realSize = class2size(size2class(sz));
+      if (HL_EXPECT_TRUE(realSize <= SuperHeap::_maxObjectSize)) HL_LIKELY {
+        return realSize;
+      }
+      return HL::good_size (SuperHeap::bigheap, realSize);
+    }
+
+    /// Like malloc, but zero-filled: recycled objects are cleared,
+    /// while fresh ones come zeroed from the underlying heaps.
+    inline void * malloc_zeroed (const size_t sz) {
+      void * ptr = nullptr;
+      const auto sizeClass   = size2class(sz);
+      const auto realSize = class2size(sizeClass);
+
+      if (HL_EXPECT_TRUE(realSize <= SuperHeap::_maxObjectSize)) HL_LIKELY {
+        assert (sizeClass >= 0);
+        assert (sizeClass < NumBins);
+        HL_ASSUME(sizeClass >= 0);
+        HL_ASSUME(sizeClass < NumBins);
+        ptr = HL::malloc_zeroed (SuperHeap::myLittleHeap[sizeClass], realSize);
+      }
+      if (HL_EXPECT_FALSE(!ptr)) HL_UNLIKELY {
+        ptr = HL::malloc_zeroed (SuperHeap::bigheap, realSize);
+      }
+      return ptr;
+    }
+
+    /**
+     * Aligned allocation. The object at the head of the size class's
+     * bin is used if it happens to be aligned (as power-of-two classes
+     * carved at their own size are); otherwise a fresh object of the
+     * class comes from the big heap. Either way it is an ordinary
+     * member of its class, recycled by free like any other.
+     */
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (alignment <= (size_t) SuperHeap::Alignment) {
+        return malloc (sz);
+      }
+      const auto sizeClass   = size2class(sz);
+      const auto realSize = class2size(sizeClass);
+
+      if (HL_EXPECT_TRUE(realSize <= SuperHeap::_maxObjectSize)) HL_LIKELY {
+        auto& littleHeap = SuperHeap::myLittleHeap[sizeClass];
+        void * ptr = littleHeap.malloc (realSize);
+        if (ptr != nullptr) {
+          if (((uintptr_t) ptr & (alignment - 1)) == 0) {
+            return ptr;
+          }
+          littleHeap.free (ptr);
+        }
+      }
+      return HL::memalign (SuperHeap::bigheap, alignment, realSize);
+    }
+
     inline void free (void * ptr) {
       const auto objectSize = SuperHeap::getSize(ptr);
       free(ptr, objectSize);
@@ -136,6 +237,51 @@ namespace HL {
       }
     }
 
+    /// Resize in place if the new size would land in the object's
+    /// own size class; big objects are resized by the big heap.
+    inline bool try_resize (void * ptr, size_t newSize) {
+      const auto objectSize = SuperHeap::getSize(ptr);
+      if (HL_EXPECT_FALSE(objectSize > SuperHeap::_maxObjectSize)) HL_UNLIKELY {
+        if (newSize <= SuperHeap::_maxObjectSize) {
+          return false;
+        }
+        if (newSize <= objectSize) {
+          return true;
+        }
+        return HL::try_resize (SuperHeap::bigheap, ptr, newSize);
+      }
+      return (newSize <= objectSize) && (size2class(newSize) == size2class(objectSize));
+    }
+
+  private:
+
+    // Returning objects to the big heap would not release anything,
+    // so just empty the bins, then release the big heap wholesale.
+    void drainBins (std::true_type) {
+      for (auto i = 0; i < NumBins; i++) {
+        SuperHeap::myLittleHeap[i].discard();
+      }
+      SuperHeap::bigheap.clear();
+    }
+
+    bool clearBigHeap (ClearBudget& budget, std::true_type) {
+      return HL::clear_step (SuperHeap::bigheap, budget);
+    }
+
+    bool clearBigHeap (ClearBudget&, std::false_type) {
+      return true;
+    }
+
+    void drainBins (std::false_type) {
+      for (auto i = 0; i < NumBins; i++) {
+        const size_t sz = class2size(i);
+        void * ptr;
+        while ((ptr = SuperHeap::myLittleHeap[i].malloc (sz)) != NULL) {
+          SuperHeap::bigheap.free (ptr);
+        }
+      }
+    }
+
   };
 
 }
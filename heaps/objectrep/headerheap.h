@@ -30,7 +30,11 @@
  * but does not provide getHeader() or initialization hooks.
  */
 
+#include "utility/clearbudget.h"
 #include "utility/gcd.h"
+#include "utility/memalign.h"
+#include "utility/tryresize.h"
+#include "utility/zeromemory.h"
 
 namespace HL {
 
@@ -46,10 +50,40 @@ namespace HL {
       return (void *) (p + 1);
     }
 
+    inline void * malloc_zeroed (size_t sz) {
+      Header * p = (Header *) HL::malloc_zeroed (static_cast<SuperHeap&>(*this), sz + sizeof(Header));
+      return (void *) (p + 1);
+    }
+
+    /// Aligned allocation. The header must sit right before the
+    /// object, so a stricter alignment means padding the front of the
+    /// block. Only possible when the super heap's free is a no-op, since
+    /// free would otherwise hand it a pointer into its object (a
+    /// subclass that can tell padded objects apart, like SizeHeap,
+    /// must record the block's start itself).
+    inline void * memalign (size_t alignment, size_t sz) {
+      static_assert (free_is_noop<SuperHeap>::value,
+		     "Padded objects would be freed by their header, not their block.");
+      if (alignment <= (size_t) Alignment) {
+	return malloc (sz);
+      }
+      // Round the header space up to the alignment (a power of two).
+      const size_t pad = (sizeof(Header) + alignment - 1) & ~(alignment - 1);
+      auto * p = (char *) HL::memalign (static_cast<SuperHeap&>(*this), alignment, sz + pad);
+      if (p == nullptr) {
+	return nullptr;
+      }
+      return (void *) (p + pad);
+    }
+
     inline void free (void * ptr) {
       SuperHeap::free (getHeader(ptr));
     }
 
+    inline bool try_resize (void * ptr, size_t sz) {
+      return HL::try_resize (static_cast<SuperHeap&>(*this), getHeader(ptr), sz + sizeof(Header));
+    }
+
     inline static Header * getHeader (const void * ptr) {
       return ((Header *) ptr - 1);
     }
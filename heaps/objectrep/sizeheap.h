@@ -24,6 +24,9 @@
  */
 
 #include <assert.h>
+#include <stdint.h>
+
+#include <type_traits>
 
 #include "heaps/objectrep/headerheap.h"
 #include "utility/cpp23compat.h"
@@ -41,6 +44,10 @@ namespace HL {
    *
    * Uses HeaderHeap to prepend a header containing the requested size
    * and a magic number for validation.
+   *
+   * Aligned objects from a superheap with a real free are carved from
+   * inside an over-sized block; their header carries a second magic
+   * number, and the word before it points back to the block.
    */
 
   template <class SuperHeap>
@@ -51,6 +58,7 @@ namespace HL {
     using Base = HeaderHeap<SizeHeapHeader, SuperHeap>;
 
     enum { MAGIC_NUMBER = 0xCAFEBABE };
+    enum { ALIGNED_MAGIC_NUMBER = 0xCAFEBA5E };
 
   public:
 
@@ -63,15 +71,30 @@ namespace HL {
       return ptr;
     }
 
+    inline void * malloc_zeroed (size_t sz) {
+      void * ptr = Base::malloc_zeroed (sz);
+      Base::getHeader(ptr)->_sz = sz;
+      Base::getHeader(ptr)->_magic = MAGIC_NUMBER;
+      return ptr;
+    }
+
+    inline void * memalign (size_t alignment, size_t sz) {
+      return alignedMalloc (alignment, sz, free_is_noop<SuperHeap>());
+    }
+
     inline void free (void * ptr) {
-      if (HL_EXPECT_TRUE(Base::getHeader(ptr)->_magic == MAGIC_NUMBER)) HL_LIKELY {
+      const auto magic = Base::getHeader(ptr)->_magic;
+      if (HL_EXPECT_TRUE(magic == MAGIC_NUMBER)) HL_LIKELY {
 	// Probably one of our objects.
 	Base::free (ptr);
+      } else if (magic == ALIGNED_MAGIC_NUMBER) {
+	SuperHeap::free (blockStart (ptr));
       }
     }
 
     inline static size_t getSize (const void * ptr) {
-      if (HL_EXPECT_TRUE(Base::getHeader(ptr)->_magic == MAGIC_NUMBER)) HL_LIKELY {
+      const auto magic = Base::getHeader(ptr)->_magic;
+      if (HL_EXPECT_TRUE((magic == MAGIC_NUMBER) || (magic == ALIGNED_MAGIC_NUMBER))) HL_LIKELY {
 	size_t size = Base::getHeader(ptr)->_sz;
 	return size;
       } else HL_UNLIKELY {
@@ -80,8 +103,53 @@ namespace HL {
       }
     }
 
+    inline bool try_resize (void * ptr, size_t sz) {
+      if (HL_EXPECT_FALSE(Base::getHeader(ptr)->_magic != MAGIC_NUMBER)) HL_UNLIKELY {
+	return false;
+      }
+      if (Base::try_resize (ptr, sz)) {
+	setSize (ptr, sz);
+	return true;
+      }
+      return false;
+    }
+
   private:
 
+    /// Pad the front of the block (the superheap never frees it).
+    inline void * alignedMalloc (size_t alignment, size_t sz, std::true_type) {
+      void * ptr = Base::memalign (alignment, sz);
+      if (ptr != nullptr) {
+	Base::getHeader(ptr)->_sz = sz;
+	Base::getHeader(ptr)->_magic = MAGIC_NUMBER;
+      }
+      return ptr;
+    }
+
+    /// Align inside an over-sized block, and record where it starts.
+    inline void * alignedMalloc (size_t alignment, size_t sz, std::false_type) {
+      if (alignment <= (size_t) Base::Alignment) {
+	return malloc (sz);
+      }
+      const size_t overhead = sizeof(void *) + sizeof(SizeHeapHeader);
+      if (sz > (size_t) -1 - overhead - alignment) {
+	return nullptr;
+      }
+      auto * block = (char *) SuperHeap::malloc (sz + overhead + alignment - 1);
+      if (block == nullptr) {
+	return nullptr;
+      }
+      auto * ptr = (void *) (((uintptr_t) block + overhead + alignment - 1) & ~(uintptr_t) (alignment - 1));
+      reinterpret_cast<void **>(Base::getHeader(ptr))[-1] = block;
+      Base::getHeader(ptr)->_sz = sz;
+      Base::getHeader(ptr)->_magic = ALIGNED_MAGIC_NUMBER;
+      return ptr;
+    }
+
+    inline static void * blockStart (void * ptr) {
+      return reinterpret_cast<void **>(Base::getHeader(ptr))[-1];
+    }
+
     inline static void setSize (void * ptr, size_t sz) {
       assert (Base::getHeader(ptr)->_magic == MAGIC_NUMBER);
       Base::getHeader(ptr)->_sz = sz;
@@ -19,8 +19,14 @@
 #define HL_BUMPALLOC_H
 
 #include <cstddef>
+#include <cstdint>
 
 #include "utility/gcd.h"
+#include "utility/clearbudget.h"
+#include "utility/heapstats.h"
+#include "utility/trim.h"
+#include "utility/tunables.h"
+#include "utility/zeromemory.h"
 
 #if defined(__clang__)
 #pragma clang diagnostic push
@@ -43,9 +49,19 @@ namespace HL {
 
     enum { Alignment = Alignment_ };
 
+    /// Memory is never reclaimed object by object.
+    enum { FreeIsNoop = 1 };
+
+    /// Space given back by try_resize may be handed out again, so
+    /// use malloc_zeroed rather than assuming zeroes.
+    enum { ZeroMemory = 0 };
+
     BumpAlloc()
       : _bump (nullptr),
-	_remaining (0)
+	_remaining (0),
+	_last (nullptr),
+	_dirtyEnd (nullptr),
+	_chunkBytes (0)
     {
       static_assert((int) gcd<ChunkSize, Alignment>::VALUE == Alignment,
 		    "Alignment must be satisfiable.");
@@ -68,14 +84,85 @@ namespace HL {
       char * old = _bump;
       _bump += newSize;
       _remaining -= newSize;
+      _last = old;
 
       assert ((size_t) old % Alignment == 0);
       return old;
     }
 
+    /// Like malloc, but zero-filled; chunks from a zeroing source only
+    /// need clearing below the dirty watermark.
+    inline void * malloc_zeroed (size_t sz) {
+      auto * ptr = (char *) malloc (sz);
+      if (!zero_memory<SuperHeap>::value) {
+	memset (ptr, 0, sz);
+      } else if (ptr < _dirtyEnd) {
+	const size_t dirty = (size_t) (_dirtyEnd - ptr);
+	memset (ptr, 0, (dirty < sz) ? dirty : sz);
+      }
+      return ptr;
+    }
+
+    /// Allocate on a stricter boundary by skipping the bump pointer
+    /// ahead (in a fresh chunk if this one is too full).
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (alignment <= Alignment) {
+	return malloc (sz);
+      }
+      size_t newSize = (sz + Alignment - 1UL) & ~(Alignment - 1UL);
+      size_t pad = (size_t) (-(uintptr_t) _bump) & (alignment - 1);
+      if (_remaining < pad + newSize) {
+	refill (newSize + alignment);
+	pad = (size_t) (-(uintptr_t) _bump) & (alignment - 1);
+      }
+      _bump += pad;
+      _remaining -= pad;
+      return malloc (sz);
+    }
+
+    /// Discard the untouched pages at the end of the current chunk
+    /// (all but pad bytes of it), if the memory is page-backed.
+    inline size_t trim (size_t pad) {
+      if (!page_backed<SuperHeap>::value || (_remaining <= pad)) {
+	return 0;
+      }
+      const auto released = release_pages (_bump + pad, _remaining - pad, 0);
+      if (released && (_dirtyEnd > _bump + pad)) {
+	_dirtyEnd = _bump + pad;
+      }
+      return released;
+    }
+
+    /// Report our chunks (all the memory we got from the superheap).
+    void collect_stats (HeapStats& stats) {
+      stats.arenaBytes += _chunkBytes;
+      stats.unusedBytes += _remaining;
+      if (page_backed<SuperHeap>::value) {
+	stats.mmapBytes += _chunkBytes;
+      }
+    }
+
     /// Free is disabled (we only bump, never reclaim).
     inline bool free (void *) { return false; }
 
+    /// Resize the most recent object by moving the bump pointer.
+    inline bool try_resize (void * ptr, size_t sz) {
+      if ((ptr == nullptr) || (ptr != _last)) {
+	return false;
+      }
+      size_t newSize = (sz + Alignment - 1UL) & ~(Alignment - 1UL);
+      const auto available = (size_t) (_bump - _last) + _remaining;
+      if (newSize > available) {
+	return false;
+      }
+      if (_bump > _dirtyEnd) {
+	_dirtyEnd = _bump;
+      }
+      _bump = _last + newSize;
+      _remaining = available - newSize;
+      return true;
+    }
+
   private:
 
     /// The bump pointer.
@@ -84,14 +171,27 @@ namespace HL {
     /// How much space remains in the current chunk.
     size_t _remaining;
 
+    /// The most recently allocated object.
+    char * _last;
+
+    /// The end of the space in the current chunk that has been handed out before.
+    char * _dirtyEnd;
+
+    /// The total size of the chunks we have obtained.
+    size_t _chunkBytes;
+
     // Get another chunk.
     void refill (size_t sz) {
-      if (sz < ChunkSize) {
-      	sz = ChunkSize;
+      const size_t tunedSize = Tunables::get (Tunables::BumpChunkSize);
+      const size_t chunkSize = tunedSize ? ((tunedSize + Alignment - 1UL) & ~(Alignment - 1UL)) : ChunkSize;
+      if (sz < chunkSize) {
+      	sz = chunkSize;
       }
       _bump = (char *) SuperHeap::malloc (sz);
       assert ((size_t) _bump % Alignment == 0);
       _remaining = sz;
+      _dirtyEnd = nullptr;
+      _chunkBytes += sz;
     }
 
   };
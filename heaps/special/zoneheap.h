@@ -31,6 +31,12 @@
 #include <assert.h>
 
 #include "utility/align.h"
+#include "utility/clearbudget.h"
+#include "utility/gcd.h"
+#include "utility/heapstats.h"
+#include "utility/trim.h"
+#include "utility/tunables.h"
+#include "utility/zeromemory.h"
 #include "wrappers/mallocinfo.h"
 
 namespace HL {
@@ -39,12 +45,22 @@ namespace HL {
   class ZoneHeap : public SuperHeap {
   public:
 
-    enum { Alignment = SuperHeap::Alignment };
+    /// Objects are carved at MallocInfo::Alignment offsets into arenas.
+    enum { Alignment = gcd<(int) SuperHeap::Alignment, (int) HL::MallocInfo::Alignment>::value };
+
+    /// Objects are only reclaimed when the whole zone is cleared.
+    enum { FreeIsNoop = 1 };
+
+    /// Space given back by try_resize may be handed out again, so
+    /// use malloc_zeroed rather than assuming zeroes.
+    enum { ZeroMemory = 0 };
 
     ZoneHeap()
       : _sizeRemaining (0),
 	_currentArena (nullptr),
-	_pastArenas (nullptr)
+	_pastArenas (nullptr),
+	_lastObject (nullptr),
+	_dirtyEnd (nullptr)
     {}
 
     ~ZoneHeap()
@@ -58,12 +74,100 @@ namespace HL {
       return ptr;
     }
 
+    /// Like malloc, but zero-filled. Zone memory from a zeroing source
+    /// only needs clearing below the dirty watermark (space handed
+    /// out once already and given back by try_resize).
+    inline void * malloc_zeroed (size_t sz) {
+      auto * ptr = (char *) zoneMalloc (sz);
+      if (ptr == nullptr) {
+	return nullptr;
+      }
+      if (!zero_memory<SuperHeap>::value) {
+	memset (ptr, 0, sz);
+      } else if (ptr < _dirtyEnd) {
+	const size_t dirty = (size_t) (_dirtyEnd - ptr);
+	memset (ptr, 0, (dirty < sz) ? dirty : sz);
+      }
+      return ptr;
+    }
+
+    /// Allocate on a stricter boundary by skipping the bump pointer
+    /// ahead (in a fresh arena if this one is too full). The skipped
+    /// space is never handed out.
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (alignment <= (size_t) HL::MallocInfo::Alignment) {
+	return zoneMalloc (sz);
+      }
+      sz = HL::align<HL::MallocInfo::Alignment>(sz);
+      if ((_currentArena == nullptr) || (padding (alignment) + sz > _sizeRemaining)) {
+	if (!newArena (sz + alignment)) {
+	  return nullptr;
+	}
+      }
+      const auto pad = padding (alignment);
+      _currentArena->arenaSpace += pad;
+      _sizeRemaining -= pad;
+      return zoneMalloc (sz);
+    }
+
     /// Free in a zone allocator is a no-op.
     inline void free (void *) {}
 
     /// Remove in a zone allocator is a no-op.
     inline int remove (void *) { return 0; }
 
+    /// Only the most recent object can be resized: it ends at the bump
+    /// pointer, so it can grow into (or shrink back to) the free space.
+    inline bool try_resize (void * ptr, size_t sz) {
+      if ((ptr == nullptr) || (ptr != _lastObject)) {
+	return false;
+      }
+      sz = HL::align<HL::MallocInfo::Alignment>(sz);
+      const auto available = (size_t) (_currentArena->arenaSpace - (char *) ptr) + _sizeRemaining;
+      if (sz > available) {
+	return false;
+      }
+      if (_currentArena->arenaSpace > _dirtyEnd) {
+	_dirtyEnd = _currentArena->arenaSpace;
+      }
+      _currentArena->arenaSpace = (char *) ptr + sz;
+      _sizeRemaining = available - sz;
+      return true;
+    }
+
+    /// Discard the untouched pages at the end of the current arena
+    /// (all but pad bytes of it), if the memory is page-backed. Arenas
+    /// still hold live objects, so none can be released outright.
+    inline size_t trim (size_t pad) {
+      if (!page_backed<SuperHeap>::value || (_currentArena == nullptr) || (_sizeRemaining <= pad)) {
+	return 0;
+      }
+      auto * start = _currentArena->arenaSpace + pad;
+      const auto released = release_pages (start, _sizeRemaining - pad, 0);
+      // Whatever was written past the bump pointer is now zero again.
+      if (released && (_dirtyEnd > start)) {
+	_dirtyEnd = start;
+      }
+      return released;
+    }
+
+    /// Report our arenas. They are all the memory we got from the
+    /// superheap, so it is not asked in turn.
+    void collect_stats (HeapStats& stats) {
+      size_t bytes = 0;
+      for (auto * arena = _pastArenas; arena != nullptr; arena = arena->nextArena) {
+	bytes += arena->arenaSize;
+      }
+      if (_currentArena != nullptr) {
+	bytes += _currentArena->arenaSize;
+	stats.unusedBytes += _sizeRemaining;
+      }
+      stats.arenaBytes += bytes;
+      if (page_backed<SuperHeap>::value) {
+	stats.mmapBytes += bytes;
+      }
+    }
+
     void clear() {
       // printf ("deleting arenas!\n");
       // Delete all of our arenas.
@@ -80,6 +184,37 @@ namespace HL {
       _currentArena = nullptr;
       _sizeRemaining = 0;
       _pastArenas = nullptr;
+      _lastObject = nullptr;
+      _dirtyEnd = nullptr;
+    }
+
+    /// Release arenas (whole spans, without visiting their objects)
+    /// while the budget allows, checking it before each one; returns
+    /// true once the zone is empty.
+    bool clear_step (ClearBudget& budget) {
+      while (_pastArenas != nullptr) {
+	if (!budget.allows()) {
+	  return false;
+	}
+	auto oldPtr = _pastArenas;
+	_pastArenas = _pastArenas->nextArena;
+	const auto sz = oldPtr->arenaSize;
+	SuperHeap::free (oldPtr, sz);
+	budget.charge (sz);
+      }
+      if (_currentArena != nullptr) {
+	if (!budget.allows()) {
+	  return false;
+	}
+	const auto sz = _currentArena->arenaSize;
+	SuperHeap::free ((void *) _currentArena, sz);
+	_currentArena = nullptr;
+	_sizeRemaining = 0;
+	budget.charge (sz);
+      }
+      _lastObject = nullptr;
+      _dirtyEnd = nullptr;
+      return true;
     }
 
   private:
@@ -93,36 +228,60 @@ namespace HL {
       sz = HL::align<HL::MallocInfo::Alignment>(sz);
       // Get more space in our arena if there's not enough room in this one.
       if ((_currentArena == nullptr) || (_sizeRemaining < sz)) {
-	// First, add this arena to our past arena list.
-	if (_currentArena != nullptr) {
-	  _currentArena->nextArena = _pastArenas;
-	  _pastArenas = _currentArena;
-	}
-	// Now get more memory.
-	size_t allocSize = ChunkSize;
-	if (allocSize < sz) {
-	  allocSize = sz;
-	}
-	_currentArena =
-	  (Arena *) SuperHeap::malloc (allocSize + sizeof(Arena));
-	if (_currentArena == nullptr) {
+	if (!newArena (sz)) {
 	  return nullptr;
 	}
-	_currentArena->arenaSpace = (char *) (_currentArena + 1);
-	_currentArena->nextArena = nullptr;
-	_currentArena->arenaSize = allocSize + sizeof(Arena);
-	_sizeRemaining = allocSize;
       }
       // Bump the pointer and update the amount of memory remaining.
       _sizeRemaining -= sz;
       ptr = _currentArena->arenaSpace;
       _currentArena->arenaSpace += sz;
+      _lastObject = ptr;
       assert (ptr != nullptr);
       //      assert ((size_t) ptr % SuperHeap::Alignment == 0);
       return ptr;
     }
   
-    class Arena {
+    /// How far the bump pointer must move to reach the given alignment.
+    inline size_t padding (size_t alignment) const {
+      return (size_t) (-(uintptr_t) _currentArena->arenaSpace) & (alignment - 1);
+    }
+
+    /// Retire the current arena and start one with room for at least sz bytes.
+    bool newArena (size_t sz) {
+      // First, add this arena to our past arena list.
+      if (_currentArena != nullptr) {
+	_currentArena->nextArena = _pastArenas;
+	_pastArenas = _currentArena;
+      }
+      // Now get more memory (in chunks of the tuned size, if one is set).
+      const size_t tunedSize = Tunables::get (Tunables::ZoneChunkSize);
+      size_t allocSize = HL::align<HL::MallocInfo::Alignment>(tunedSize ? tunedSize : ChunkSize);
+      if (allocSize < sz) {
+	allocSize = sz;
+      }
+      _currentArena =
+	(Arena *) SuperHeap::malloc (allocSize + sizeof(Arena));
+      if (_currentArena == nullptr) {
+	// The last object (if any) is in a past arena now, so it can no
+	// longer be resized.
+	_sizeRemaining = 0;
+	_lastObject = nullptr;
+	_dirtyEnd = nullptr;
+	return false;
+      }
+      _currentArena->arenaSpace = (char *) (_currentArena + 1);
+      _currentArena->nextArena = nullptr;
+      _currentArena->arenaSize = allocSize + sizeof(Arena);
+      _sizeRemaining = allocSize;
+      _dirtyEnd = nullptr;
+      return true;
+    }
+
+    // Aligned so that the space after the header starts on an
+    // allocation boundary (the assertion below never fires otherwise,
+    // since Arena's constructor is never instantiated).
+    class alignas(HL::MallocInfo::Alignment) Arena {
     public:
       Arena() {
 	static_assert((sizeof(Arena) % HL::MallocInfo::Alignment == 0),
@@ -142,6 +301,12 @@ namespace HL {
 
     /// A linked list of past arenas.
     Arena * _pastArenas;
+
+    /// The most recently allocated object (the only one try_resize can move the bump pointer for).
+    void * _lastObject;
+
+    /// The end of the space in the current arena that has been handed out before.
+    char * _dirtyEnd;
   };
 
 }
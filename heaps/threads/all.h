@@ -4,3 +4,7 @@
 #include "threadspecificheap.h"
 #include "sizethreadheap.h"
 
+#include "percpuheap.h"
+#include "threadcacheheap.h"
+#include "hoardheap.h"
+#include "shardedlockedheap.h"
@@ -0,0 +1,479 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_HOARDHEAP_H
+#define HL_HOARDHEAP_H
+
+#if !defined(_WIN32) // not implemented for Windows
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+#include "heaps/top/mmapheap.h"
+#include "threads/threadindex.h"
+#include "utility/cpp23compat.h"
+#include "utility/heapstats.h"
+#include "utility/ilog2.h"
+#include "utility/modulo.h"
+
+/**
+ * @class HoardHeap
+ * @brief Per-thread heaps of superblocks, with bounded blowup (as in Hoard).
+ *
+ * Memory comes in superblocks: SuperblockSize-aligned spans, each
+ * holding objects of one power-of-two class behind a header, so the
+ * header of any object is found by masking its address. Threads
+ * allocate from their own heap (picked by ThreadIndex, as in
+ * ThreadHeap) under that heap's lock. An object is always freed to
+ * the heap that owns its superblock, whichever thread frees it.
+ *
+ * Private heaps alone let memory freed into one heap sit idle while
+ * another heap asks for more. So each heap watches, per class, how
+ * much of what it holds is in use: once more than 1/Groups of it
+ * (and more than Slack superblocks' worth) is free, it hands its
+ * emptiest superblock to a global heap, from which any heap can take
+ * it back. Memory held is thus within a constant factor of memory in
+ * use (plus Slack superblocks per heap and class), while most
+ * operations touch only one heap. Empty superblocks in the global
+ * heap can be reused for any class, and trim returns them to
+ * SuperblockSource.
+ *
+ * Objects larger than SuperblockSize / 8 get a span of their own.
+ *
+ * @param NumHeaps The number of per-thread heaps.
+ * @param LockType The lock for each heap.
+ * @param SuperblockSource A thread-safe source of spans, with
+ *   memalign and a sized free (like SizedMmapHeap).
+ * @param SuperblockSize The superblock size (a power of two).
+ */
+
+namespace HL {
+
+  template <int NumHeaps,
+	    class LockType,
+	    class SuperblockSource = SizedMmapHeap,
+	    size_t SuperblockSize = 65536>
+  class HoardHeap {
+  public:
+
+    enum { Alignment = 16 };
+
+    enum { MinClassSize = 16 };
+    enum { MaxObjectSize = SuperblockSize / 8 };
+    enum { NumClasses = ilog2 (MaxObjectSize) - ilog2 (MinClassSize) + 1 };
+
+    /// Superblocks are grouped by fullness, in quarters; a heap more
+    /// than one group's worth empty in a class gives some back.
+    enum { Groups = 4 };
+
+    /// Superblocks' worth of free space a heap may keep per class.
+    enum { Slack = 2 };
+
+    static_assert ((SuperblockSize & (SuperblockSize - 1)) == 0,
+		   "SuperblockSize must be a power of two.");
+    static_assert (SuperblockSize >= 4096,
+		   "SuperblockSize must be at least a page.");
+
+    HoardHeap()
+      : _empty (nullptr),
+	_emptyCount (0),
+	_largeBytes (0)
+    {}
+
+    inline void * malloc (size_t sz) {
+      if (HL_EXPECT_FALSE(sz > (size_t) MaxObjectSize)) HL_UNLIKELY {
+	return largeMalloc (HeaderSize, sz);
+      }
+      const int c = sizeClass (sz);
+      const auto index = heapIndex();
+      auto& h = _heaps[index];
+      std::lock_guard<LockType> l (h.lock);
+      auto * sb = fullest (h.bins[c]);
+      if (HL_EXPECT_FALSE(sb == nullptr)) HL_UNLIKELY {
+	sb = fetch (c, index);
+	if (sb == nullptr) {
+	  return nullptr;
+	}
+      }
+      auto * ptr = sb->allocate();
+      h.bins[c].inUse++;
+      regroup (h.bins[c], sb);
+      return ptr;
+    }
+
+    inline void free (void * ptr) {
+      if (ptr == nullptr) {
+	return;
+      }
+      auto * sb = Superblock::of (ptr);
+      if (HL_EXPECT_FALSE(sb->sizeClass < 0)) HL_UNLIKELY {
+	largeFree (sb);
+	return;
+      }
+      // The owner can change only while its lock is held, so take the
+      // lock of the owner we see, then make sure it still is.
+      for (;;) {
+	const int owner = sb->owner.load (std::memory_order_acquire);
+	auto& h = heap (owner);
+	std::lock_guard<LockType> l (h.lock);
+	if (HL_EXPECT_FALSE(sb->owner.load (std::memory_order_relaxed) != owner)) HL_UNLIKELY {
+	  continue;
+	}
+	auto& b = h.bins[sb->sizeClass];
+	sb->release (ptr);
+	b.inUse--;
+	regroup (b, sb);
+	if (owner == GlobalHeap) {
+	  if (sb->used == 0) {
+	    unlink (b, sb);
+	    b.superblocks--;
+	    pushEmpty (sb);
+	  }
+	} else if (tooEmpty (b, sb->capacity)) {
+	  std::lock_guard<LockType> g (_global.lock);
+	  giveBack (b, sb->sizeClass);
+	}
+	return;
+      }
+    }
+
+    /// Alignments up to the header size come from the size classes
+    /// (objects at least that big are aligned to it); stricter ones,
+    /// below SuperblockSize, from spans of their own.
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (alignment <= (size_t) Alignment) {
+	return malloc (sz);
+      }
+      if (alignment <= (size_t) HeaderSize) {
+	return malloc ((sz < alignment) ? alignment : sz);
+      }
+      if (alignment >= SuperblockSize) {
+	return nullptr;
+      }
+      return largeMalloc (alignment, sz);
+    }
+
+    inline size_t getSize (void * ptr) {
+      return Superblock::of (ptr)->objectSize;
+    }
+
+    /// Return the global heap's empty superblocks beyond pad bytes'
+    /// worth to SuperblockSource.
+    inline size_t trim (size_t pad) {
+      std::lock_guard<LockType> g (_global.lock);
+      size_t released = 0;
+      while ((_empty != nullptr) && (_emptyCount * SuperblockSize > pad)) {
+	auto * sb = _empty;
+	_empty = sb->next;
+	_emptyCount--;
+	_source.free (sb, SuperblockSize);
+	released += SuperblockSize;
+      }
+      return released;
+    }
+
+    inline void collect_stats (HeapStats& stats) {
+      for (auto& h : _heaps) {
+	std::lock_guard<LockType> l (h.lock);
+	addStats (h, stats);
+      }
+      std::lock_guard<LockType> g (_global.lock);
+      addStats (_global, stats);
+      stats.arenaBytes += _emptyCount * SuperblockSize;
+      stats.unusedBytes += _emptyCount * SuperblockSize;
+      stats.directBytes += _largeBytes.load (std::memory_order_relaxed);
+    }
+
+    /// Take every lock (for fork).
+    inline void lock() {
+      for (auto& h : _heaps) {
+	h.lock.lock();
+      }
+      _global.lock.lock();
+    }
+
+    inline void unlock() {
+      _global.lock.unlock();
+      for (int i = NumHeaps - 1; i >= 0; i--) {
+	_heaps[i].lock.unlock();
+      }
+    }
+
+  private:
+
+    enum { GlobalHeap = NumHeaps };
+
+    struct FreeObject {
+      FreeObject * next;
+    };
+
+    class alignas(64) Superblock {
+    public:
+
+      static inline Superblock * of (void * ptr) {
+	return reinterpret_cast<Superblock *>((uintptr_t) ptr & ~(uintptr_t) (SuperblockSize - 1));
+      }
+
+      void format (int c) {
+	sizeClass = c;
+	objectSize = classSize (c);
+	capacity = (unsigned int) ((SuperblockSize - HeaderSize) / objectSize);
+	used = 0;
+	freeList = nullptr;
+	bump = reinterpret_cast<char *>(this) + HeaderSize;
+	prev = next = nullptr;
+      }
+
+      inline void * allocate() {
+	used++;
+	if (freeList != nullptr) {
+	  auto * obj = freeList;
+	  freeList = obj->next;
+	  return obj;
+	}
+	auto * obj = bump;
+	bump += objectSize;
+	return obj;
+      }
+
+      inline void release (void * ptr) {
+	auto * obj = reinterpret_cast<FreeObject *>(ptr);
+	obj->next = freeList;
+	freeList = obj;
+	used--;
+      }
+
+      std::atomic<int> owner;
+      int sizeClass;		///< -1 for a large object
+      size_t objectSize;
+      size_t spanSize;		///< (large objects only)
+      unsigned int capacity;
+      unsigned int used;
+      int group;
+      FreeObject * freeList;
+      char * bump;
+      Superblock * prev;
+      Superblock * next;
+    };
+
+    enum { HeaderSize = sizeof(Superblock) };
+
+    static_assert ((HeaderSize & (HeaderSize - 1)) == 0,
+		   "The superblock header must fill a power-of-two size.");
+
+    /// One class in one heap: superblocks by fullness (Groups holds
+    /// the full ones) and counts for the emptiness test.
+    struct Bin {
+      Superblock * groups[Groups + 1];
+      size_t superblocks;
+      size_t inUse;
+    };
+
+    struct alignas(64) Heap {
+      LockType lock;
+      Bin bins[NumClasses] = {};
+    };
+
+    static inline int sizeClass (size_t sz) {
+      return (int) ilog2 ((sz < MinClassSize) ? (size_t) MinClassSize : sz) - (int) ilog2 (MinClassSize);
+    }
+
+    static inline size_t classSize (int c) {
+      return (size_t) MinClassSize << c;
+    }
+
+    static inline unsigned int heapIndex() {
+      return Modulo<NumHeaps>::mod (ThreadIndex::get());
+    }
+
+    inline Heap& heap (int index) {
+      return (index == GlobalHeap) ? _global : _heaps[index];
+    }
+
+    static inline int groupOf (const Superblock * sb) {
+      return (int) ((size_t) sb->used * Groups / sb->capacity);
+    }
+
+    static void link (Bin& b, Superblock * sb) {
+      sb->group = groupOf (sb);
+      auto *& head = b.groups[sb->group];
+      sb->prev = nullptr;
+      sb->next = head;
+      if (head != nullptr) {
+	head->prev = sb;
+      }
+      head = sb;
+    }
+
+    static void unlink (Bin& b, Superblock * sb) {
+      if (sb->prev != nullptr) {
+	sb->prev->next = sb->next;
+      } else {
+	b.groups[sb->group] = sb->next;
+      }
+      if (sb->next != nullptr) {
+	sb->next->prev = sb->prev;
+      }
+    }
+
+    static inline void regroup (Bin& b, Superblock * sb) {
+      if (groupOf (sb) != sb->group) {
+	unlink (b, sb);
+	link (b, sb);
+      }
+    }
+
+    /// The fullest superblock with room, if any (so that the emptier
+    /// ones can drain).
+    static inline Superblock * fullest (Bin& b) {
+      for (int g = Groups - 1; g >= 0; g--) {
+	if (b.groups[g] != nullptr) {
+	  return b.groups[g];
+	}
+      }
+      return nullptr;
+    }
+
+    /// True if the bin holds more than Slack superblocks' worth and
+    /// more than 1/Groups of its space free.
+    static inline bool tooEmpty (const Bin& b, size_t capacity) {
+      const size_t held = b.superblocks * capacity;
+      return (held - b.inUse > Slack * capacity)
+	&& (b.inUse * Groups < held * (Groups - 1));
+    }
+
+    /// Move the bin's emptiest superblock to the global heap (with
+    /// both locks held). One at least 1/Groups empty exists whenever
+    /// tooEmpty holds.
+    void giveBack (Bin& b, int c) {
+      Superblock * sb = nullptr;
+      for (int g = 0; (g < Groups - 1) && (sb == nullptr); g++) {
+	sb = b.groups[g];
+      }
+      if (sb == nullptr) {
+	return;
+      }
+      unlink (b, sb);
+      b.superblocks--;
+      b.inUse -= sb->used;
+      sb->owner.store (GlobalHeap, std::memory_order_release);
+      if (sb->used == 0) {
+	pushEmpty (sb);
+      } else {
+	auto& gb = _global.bins[c];
+	link (gb, sb);
+	gb.superblocks++;
+	gb.inUse += sb->used;
+      }
+    }
+
+    /// A superblock with room for class c, moved from the global heap
+    /// (or made) into heap index, whose lock is held.
+    Superblock * fetch (int c, unsigned int index) {
+      Superblock * sb;
+      {
+	std::lock_guard<LockType> g (_global.lock);
+	auto& gb = _global.bins[c];
+	sb = fullest (gb);
+	if (sb != nullptr) {
+	  unlink (gb, sb);
+	  gb.superblocks--;
+	  gb.inUse -= sb->used;
+	} else if (_empty != nullptr) {
+	  sb = _empty;
+	  _empty = sb->next;
+	  _emptyCount--;
+	  sb->format (c);
+	} else {
+	  sb = reinterpret_cast<Superblock *>(_source.memalign (SuperblockSize, SuperblockSize));
+	  if (sb == nullptr) {
+	    return nullptr;
+	  }
+	  new (sb) Superblock;
+	  sb->format (c);
+	}
+	sb->owner.store ((int) index, std::memory_order_release);
+      }
+      auto& b = _heaps[index].bins[c];
+      link (b, sb);
+      b.superblocks++;
+      b.inUse += sb->used;
+      return sb;
+    }
+
+    /// With the global lock held.
+    void pushEmpty (Superblock * sb) {
+      sb->next = _empty;
+      _empty = sb;
+      _emptyCount++;
+    }
+
+    /// A span of its own for one object, offset bytes in.
+    void * largeMalloc (size_t offset, size_t sz) {
+      const size_t spanSize = offset + sz;
+      if (spanSize < sz) {
+	return nullptr;
+      }
+      auto * sb = reinterpret_cast<Superblock *>(_source.memalign (SuperblockSize, spanSize));
+      if (sb == nullptr) {
+	return nullptr;
+      }
+      new (sb) Superblock;
+      sb->sizeClass = -1;
+      sb->spanSize = spanSize;
+      sb->objectSize = sz;
+      _largeBytes.fetch_add (spanSize, std::memory_order_relaxed);
+      return reinterpret_cast<char *>(sb) + offset;
+    }
+
+    void largeFree (Superblock * sb) {
+      const size_t spanSize = sb->spanSize;
+      _largeBytes.fetch_sub (spanSize, std::memory_order_relaxed);
+      _source.free (sb, spanSize);
+    }
+
+    static void addStats (Heap& h, HeapStats& stats) {
+      for (int c = 0; c < NumClasses; c++) {
+	const auto& b = h.bins[c];
+	if (b.superblocks == 0) {
+	  continue;
+	}
+	const size_t sz = classSize (c);
+	const size_t perSuperblock = (SuperblockSize - HeaderSize) / sz;
+	const size_t freeObjects = b.superblocks * perSuperblock - b.inUse;
+	stats.arenaBytes += b.superblocks * SuperblockSize;
+	stats.unusedBytes += b.superblocks * (SuperblockSize - perSuperblock * sz);
+	stats.addFree (c, sz, freeObjects, freeObjects * sz);
+      }
+    }
+
+    Heap _heaps[NumHeaps];
+    Heap _global;
+    Superblock * _empty;
+    size_t _emptyCount;
+    std::atomic<size_t> _largeBytes;
+    HL_NO_UNIQUE_ADDRESS SuperblockSource _source;
+  };
+
+}
+
+#endif
+
+#endif
@@ -19,8 +19,15 @@
 #define HL_LOCKEDHEAP_H
 
 #include <mutex>
+#include <utility>
 #include <cstddef>
 #include "utility/cpp23compat.h"
+#include "utility/goodsize.h"
+#include "utility/heapstats.h"
+#include "utility/memalign.h"
+#include "utility/trim.h"
+#include "utility/tryresize.h"
+#include "utility/zeromemory.h"
 
 namespace HL {
 
@@ -35,19 +42,33 @@ namespace HL {
       return Super::malloc (sz);
     }
 
+    inline void * malloc_zeroed (size_t sz) {
+      std::lock_guard<LockType> l (thelock);
+      return HL::malloc_zeroed (static_cast<Super&>(*this), sz);
+    }
+
     inline auto free (void * ptr) {
       std::lock_guard<LockType> l (thelock);
       return Super::free (ptr);
     }
 
-    inline auto free (void * ptr, size_t sz) {
+    // A template, so that heaps without a sized free can still be
+    // probed for one (as memory resources do) without a hard error.
+    template <class S = Super>
+    inline auto free (void * ptr, size_t sz) -> decltype(std::declval<S&>().free (ptr, sz)) {
       std::lock_guard<LockType> l (thelock);
-      return Super::free (ptr, sz);
+      return S::free (ptr, sz);
     }
 
     inline void * memalign (size_t alignment, size_t sz) {
       std::lock_guard<LockType> l (thelock);
-      return Super::memalign (alignment, sz);
+      return HL::memalign (static_cast<Super&>(*this), alignment, sz);
+    }
+
+    // Size-class rounding depends on nothing that changes, so it
+    // needs no lock.
+    inline size_t good_size (size_t sz) {
+      return HL::good_size (static_cast<Super&>(*this), sz);
     }
 
     inline size_t getSize (void * ptr) const {
@@ -60,6 +81,21 @@ namespace HL {
       return Super::getSize (ptr);
     }
 
+    inline bool try_resize (void * ptr, size_t sz) {
+      std::lock_guard<LockType> l (thelock);
+      return HL::try_resize (static_cast<Super&>(*this), ptr, sz);
+    }
+
+    inline size_t trim (size_t pad) {
+      std::lock_guard<LockType> l (thelock);
+      return HL::trim (static_cast<Super&>(*this), pad);
+    }
+
+    inline void collect_stats (HeapStats& stats) {
+      std::lock_guard<LockType> l (thelock);
+      HL::collect_stats (static_cast<Super&>(*this), stats);
+    }
+
     inline void lock() {
       thelock.lock();
     }
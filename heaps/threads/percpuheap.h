@@ -0,0 +1,263 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_PERCPUHEAP_H
+#define HL_PERCPUHEAP_H
+
+#if !defined(_WIN32) // not implemented for Windows
+
+#include <cstddef>
+#include <mutex>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "threads/rseq.h"
+#include "utility/cpp23compat.h"
+#include "utility/heapstats.h"
+#include "utility/ilog2.h"
+#include "utility/memalign.h"
+#include "utility/trim.h"
+
+/**
+ * @class PerCPUHeap
+ * @brief One heap per CPU, with lock-free per-CPU caches of small objects.
+ *
+ * Unlike ThreadHeap, which needs a heap per thread to keep threads
+ * apart, this picks the heap of the CPU the caller is running on, so
+ * MaxCPUs need only cover the cores, and two threads
+ * contend for a heap's lock only if one is preempted while holding
+ * it.
+ *
+ * In front of each heap sit free lists of power-of-two classes up to
+ * MaxCachedSize, pushed and popped in restartable sequences (see
+ * RSeq), so most mallocs and frees take neither a lock nor an atomic
+ * instruction. Without rseq, every call goes to the CPU's heap under
+ * its lock, with the CPU from sched_getcpu.
+ *
+ * Objects may be freed on any CPU, and there is no record of which
+ * heap an object came from: a free that the cache cannot take goes
+ * to the current CPU's heap. So each PerCPUSubHeap must accept
+ * objects that another one allocated (as heaps carving objects with
+ * headers from one shared source do). PerCPUSubHeap is not locked by
+ * the caller (this layer locks it), but its getSize must be safe
+ * without the lock, as it is for heaps with object headers.
+ *
+ * A CPU's caches can only be popped on that CPU, so trim moves the
+ * calling thread onto each CPU in turn to flush them; CPUs outside
+ * its affinity mask keep their caches.
+ *
+ * @param MaxCPUs The number of heaps (CPUs beyond share heaps, uncached).
+ * @param LockType The lock for each heap.
+ * @param PerCPUSubHeap The heap for each CPU.
+ * @param MaxCachedSize The largest cached object size (a power of two).
+ */
+
+namespace HL {
+
+  template <int MaxCPUs,
+	    class LockType,
+	    class PerCPUSubHeap,
+	    size_t MaxCachedSize = 1024>
+  class PerCPUHeap {
+  public:
+
+    enum { Alignment = PerCPUSubHeap::Alignment };
+
+    enum { MinClassSize = 16 };
+    enum { NumClasses = ilog2 (MaxCachedSize) - ilog2 (MinClassSize) + 1 };
+
+    /// Bytes each CPU may cache per class.
+    enum { CachedBytesPerClass = 64 * 1024 };
+
+    static_assert ((MaxCachedSize & (MaxCachedSize - 1)) == 0,
+		   "MaxCachedSize must be a power of two.");
+    static_assert (MaxCachedSize >= MinClassSize,
+		   "MaxCachedSize must be at least MinClassSize.");
+
+    inline void * malloc (size_t sz) {
+      if (HL_EXPECT_TRUE(sz <= MaxCachedSize)) HL_LIKELY {
+	const int c = sizeClass (sz);
+	int cpu;
+	while (((cpu = RSeq::rseqCPU()) >= 0) && (cpu < MaxCPUs)) {
+	  RSeq::Node * obj;
+	  if (HL_EXPECT_TRUE(RSeq::pop (&_caches[cpu].head[c], (unsigned int) cpu, obj) == RSeq::Done)) HL_LIKELY {
+	    if (HL_EXPECT_TRUE(obj != nullptr)) HL_LIKELY {
+	      return obj;
+	    }
+	    break;
+	  }
+	}
+	return lockedMalloc (classSize (c));
+      }
+      return lockedMalloc (sz);
+    }
+
+    inline void free (void * ptr) {
+      if (ptr == nullptr) {
+	return;
+      }
+      const size_t sz = getSize (ptr);
+      if (HL_EXPECT_TRUE((sz >= MinClassSize) && (sz <= MaxCachedSize))) HL_LIKELY {
+	// The largest class the object can hold.
+	const int c = (int) (floorLog2 (sz) - ilog2 (MinClassSize));
+	int cpu;
+	while (((cpu = RSeq::rseqCPU()) >= 0) && (cpu < MaxCPUs)) {
+	  const auto status = RSeq::push (&_caches[cpu].head[c], (unsigned int) cpu,
+					  reinterpret_cast<RSeq::Node *>(ptr), maxDepth (c));
+	  if (HL_EXPECT_TRUE(status == RSeq::Done)) HL_LIKELY {
+	    return;
+	  }
+	  if (status == RSeq::Full) {
+	    break;
+	  }
+	}
+      }
+      auto& h = currentHeap();
+      std::lock_guard<LockType> l (h.lock);
+      h.heap.free (ptr);
+    }
+
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (alignment <= (size_t) Alignment) {
+	return malloc (sz);
+      }
+      auto& h = currentHeap();
+      std::lock_guard<LockType> l (h.lock);
+      return HL::memalign (h.heap, alignment, sz);
+    }
+
+    inline size_t getSize (void * ptr) {
+      return _heaps[0].heap.getSize (ptr);
+    }
+
+    /// Hand every CPU's cached objects back to its heap (as far as the
+    /// calling thread may run there), then trim every heap.
+    inline size_t trim (size_t pad) {
+#if defined(__linux__)
+      cpu_set_t allowed;
+      if (sched_getaffinity (0, sizeof(allowed), &allowed) == 0) {
+	for (int cpu = 0; (cpu < MaxCPUs) && (cpu < CPU_SETSIZE); cpu++) {
+	  if (!CPU_ISSET (cpu, &allowed)) {
+	    continue;
+	  }
+	  cpu_set_t one;
+	  CPU_ZERO (&one);
+	  CPU_SET (cpu, &one);
+	  if (sched_setaffinity (0, sizeof(one), &one) == 0) {
+	    flushCurrentCPU();
+	  }
+	}
+	sched_setaffinity (0, sizeof(allowed), &allowed);
+      }
+#endif
+      flushCurrentCPU();
+      size_t released = 0;
+      for (auto& h : _heaps) {
+	std::lock_guard<LockType> l (h.lock);
+	released += HL::trim (h.heap, pad);
+      }
+      return released;
+    }
+
+    /// Report every heap (objects in the per-CPU caches count as in use).
+    inline void collect_stats (HeapStats& stats) {
+      for (auto& h : _heaps) {
+	std::lock_guard<LockType> l (h.lock);
+	HL::collect_stats (h.heap, stats);
+      }
+    }
+
+    /// Take every heap's lock (for fork).
+    inline void lock() {
+      for (auto& h : _heaps) {
+	h.lock.lock();
+      }
+    }
+
+    inline void unlock() {
+      for (int i = MaxCPUs - 1; i >= 0; i--) {
+	_heaps[i].lock.unlock();
+      }
+    }
+
+  private:
+
+    struct alignas(64) CPUHeap {
+      LockType lock;
+      PerCPUSubHeap heap;
+    };
+
+    struct alignas(64) CPUCache {
+      RSeq::Node * head[NumClasses];
+    };
+
+    static inline int sizeClass (size_t sz) {
+      return (int) ilog2 ((sz < MinClassSize) ? (size_t) MinClassSize : sz) - (int) ilog2 (MinClassSize);
+    }
+
+    static inline size_t classSize (int c) {
+      return (size_t) MinClassSize << c;
+    }
+
+    static inline unsigned int floorLog2 (size_t sz) {
+      return (unsigned int) (sizeof(size_t) * 8 - 1) - (unsigned int) __builtin_clzl (sz);
+    }
+
+    static inline size_t maxDepth (int c) {
+      return CachedBytesPerClass / classSize (c);
+    }
+
+    inline CPUHeap& currentHeap() {
+      return _heaps[RSeq::currentCPU() % MaxCPUs];
+    }
+
+    /// Hand the current CPU's cached objects back to its heap.
+    void flushCurrentCPU() {
+      for (int c = 0; c < NumClasses; c++) {
+	int cpu;
+	while (((cpu = RSeq::rseqCPU()) >= 0) && (cpu < MaxCPUs)) {
+	  RSeq::Node * obj;
+	  if (RSeq::pop (&_caches[cpu].head[c], (unsigned int) cpu, obj) != RSeq::Done) {
+	    continue;
+	  }
+	  if (obj == nullptr) {
+	    break;
+	  }
+	  auto& h = _heaps[cpu];
+	  std::lock_guard<LockType> l (h.lock);
+	  h.heap.free (obj);
+	}
+      }
+    }
+
+    inline void * lockedMalloc (size_t sz) {
+      auto& h = currentHeap();
+      std::lock_guard<LockType> l (h.lock);
+      return h.heap.malloc (sz);
+    }
+
+    CPUHeap _heaps[MaxCPUs];
+    CPUCache _caches[MaxCPUs] = {};
+  };
+
+}
+
+#endif
+
+#endif
@@ -4,8 +4,11 @@
 #define HL_PHOTHREADHEAP_H
 
 #include <assert.h>
+#include <atomic>
 
-#include "threads/cpuinfo.h"
+#include "threads/threadindex.h"
+#include "utility/cpp23compat.h"
+#include "utility/trim.h"
 
 #if defined(__clang__)
 #pragma clang diagnostic push
@@ -19,7 +22,7 @@ class MarkThreadHeap : public SuperHeap {
 public:
 
   inline void * malloc (size_t sz) {
-    int tid = CPUInfo::getThreadId() % NumHeaps;
+    int tid = ThreadIndex::get() % NumHeaps;
     void * ptr = SuperHeap::malloc (sz);
     if (ptr != NULL) {
       SuperHeap::setHeap(ptr, tid);
@@ -38,7 +41,7 @@ public:
     void * ptr = SuperHeap::malloc (sz);
 #ifndef NDEBUG
     if (ptr != NULL) {
-      int tid = CPUInfo::getThreadId() % NumHeaps;
+      int tid = ThreadIndex::get() % NumHeaps;
       assert (SuperHeap::getHeap(ptr) == tid);
     }
 #endif
@@ -52,16 +55,80 @@ public:
 
 
 
+/**
+ * @class RemoteFreeList
+ * @brief A multi-producer stack of freed objects, taken whole.
+ *
+ * Any thread can push with one CAS; a consumer (usually the owner)
+ * takes the whole list at once with an exchange, so there is no ABA
+ * problem even with several consumers. The link is kept in the
+ * object's first word.
+ */
+
+class alignas(64) RemoteFreeList {
+public:
+
+  RemoteFreeList()
+    : _head (nullptr)
+  {}
+
+  inline void push (void * ptr) {
+    auto * node = reinterpret_cast<Node *>(ptr);
+    auto * head = _head.load (std::memory_order_relaxed);
+    do {
+      node->next = head;
+    } while (!_head.compare_exchange_weak (head, node,
+					   std::memory_order_release,
+					   std::memory_order_relaxed));
+  }
+
+  /// True if there may be something to take (a plain load).
+  inline bool nonEmpty() const {
+    return _head.load (std::memory_order_relaxed) != nullptr;
+  }
+
+  /// Take every object, passing each to f (the owner's free).
+  template <class F>
+  inline void drain (F f) {
+    auto * node = _head.exchange (nullptr, std::memory_order_acquire);
+    while (node != nullptr) {
+      auto * next = node->next;
+      f (node);
+      node = next;
+    }
+  }
+
+private:
+
+  struct Node {
+    Node * next;
+  };
+
+  std::atomic<Node *> _head;
+};
+
+
 /*
 
 A PHOThreadHeap comprises NumHeaps "per-thread" heaps.
 
-To pick a per-thread heap, the current thread id is hashed (mod NumHeaps).
+To pick a per-thread heap, the current thread's index (see ThreadIndex)
+is taken mod NumHeaps, so up to NumHeaps threads each get their own.
 
-malloc gets memory from its hashed per-thread heap.
+malloc gets memory from its per-thread heap.
 free returns memory to its originating heap.
 
-NB: We assume that the thread heaps are 'locked' as needed.  */
+A free by a thread of the originating heap goes straight to that
+heap. Any other thread pushes the object onto the heap's remote-free
+list instead (one CAS, without the heap's lock), and the heap's own
+threads splice that list back in when they next allocate. So
+producer/consumer pipelines do not serialize on the producer's heap.
+A heap whose threads have all exited (and whose index no new thread
+has taken) never allocates again, so trim splices every heap's list
+back in before trimming the heaps.
+
+NB: We assume that the thread heaps are 'locked' as needed (beyond
+NumHeaps threads, threads share heaps).  */
 
 
 template <int NumHeaps, class SuperHeap>
@@ -69,17 +136,35 @@ class PHOThreadHeap { // : public MarkThreadHeap<NumHeaps, SuperHeap> {
 public:
 
   inline void * malloc (size_t sz) {
-    int tid = CPUInfo::getThreadId() % NumHeaps;
+    int tid = ThreadIndex::get() % NumHeaps;
+    if (HL_EXPECT_FALSE(remoteFrees[tid].nonEmpty())) HL_UNLIKELY {
+      collectRemoteFrees (tid);
+    }
     void * ptr = selectHeap(tid)->malloc (sz);
     return ptr;
   }
 
   inline void free (void * ptr) {
-    int tid = SuperHeap::getHeap(ptr);
-    selectHeap(tid)->free (ptr);
+    int owner = SuperHeap::getHeap(ptr);
+    int tid = ThreadIndex::get() % NumHeaps;
+    if (HL_EXPECT_TRUE(owner == tid)) HL_LIKELY {
+      selectHeap(owner)->free (ptr);
+    } else {
+      remoteFrees[owner].push (ptr);
+    }
   }
 
 
+  /// Return every heap's remote frees to it, then trim every heap.
+  inline size_t trim (size_t pad) {
+    size_t released = 0;
+    for (int i = 0; i < NumHeaps; i++) {
+      collectRemoteFrees (i);
+      released += HL::trim (*selectHeap(i), pad);
+    }
+    return released;
+  }
+
   inline int remove (void * ptr);
 #if 0
   {
@@ -90,6 +175,12 @@ public:
 
 private:
 
+  // Return objects freed by other threads to the heap.
+  void collectRemoteFrees (int index) {
+    auto * heap = selectHeap(index);
+    remoteFrees[index].drain ([heap] (void * ptr) { heap->free (ptr); });
+  }
+
   // Access the given heap within the buffer.
   MarkThreadHeap<NumHeaps, SuperHeap> * selectHeap (int index) {
     assert (index >= 0);
@@ -99,6 +190,8 @@ private:
 
   MarkThreadHeap<NumHeaps, SuperHeap> ptHeaps[NumHeaps];
 
+  RemoteFreeList remoteFrees[NumHeaps];
+
 };
 
 #if defined(__clang__)
@@ -0,0 +1,214 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_SHARDEDLOCKEDHEAP_H
+#define HL_SHARDEDLOCKEDHEAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "threads/threadindex.h"
+#include "utility/cpp23compat.h"
+#include "utility/gcd.h"
+#include "utility/goodsize.h"
+#include "utility/heapstats.h"
+#include "utility/memalign.h"
+#include "utility/trim.h"
+#include "utility/tryresize.h"
+
+/**
+ * @class ShardedLockedHeap
+ * @brief N copies of a heap, each behind its own lock; threads take
+ * whichever copy is free.
+ *
+ * LockedHeap makes every thread wait for one lock. Here malloc tries
+ * the calling thread's last shard with try_lock, then each of the
+ * others in turn, and waits only if all N are busy; the shard it got
+ * is remembered (per thread) for next time. Each object carries a
+ * small header naming its shard, so free returns it there, from any
+ * thread. This lets a single-threaded composition scale across cores
+ * unchanged.
+ *
+ * @param N The number of shards.
+ * @param LockType The lock for each shard (with try_lock).
+ * @param Heap The (unsynchronized) heap to replicate.
+ */
+
+namespace HL {
+
+  template <int N, class LockType, class Heap>
+  class ShardedLockedHeap {
+  public:
+
+    enum { HeaderSize = ((int) Heap::Alignment >= 16) ? 16 : 8 };
+    enum { Alignment = gcd<(int) Heap::Alignment, (int) HeaderSize>::value };
+
+    static_assert (N > 0, "There must be at least one shard.");
+
+    inline void * malloc (size_t sz) {
+      if (HL_EXPECT_FALSE(sz + HeaderSize < sz)) HL_UNLIKELY {
+	return nullptr;
+      }
+      const auto first = preferredShard();
+      for (unsigned int i = 0; i < (unsigned int) N; i++) {
+	const auto s = (first + i) % (unsigned int) N;
+	auto& shard = _shards[s];
+	std::unique_lock<LockType> l (shard.lock, std::try_to_lock);
+	if (HL_EXPECT_TRUE(l.owns_lock())) HL_LIKELY {
+	  _lastShard = s + 1;
+	  return tag (shard.heap.malloc (sz + HeaderSize), s, HeaderSize);
+	}
+      }
+      // Every shard is busy: wait for ours.
+      auto& shard = _shards[first];
+      std::lock_guard<LockType> l (shard.lock);
+      return tag (shard.heap.malloc (sz + HeaderSize), first, HeaderSize);
+    }
+
+    inline void free (void * ptr) {
+      if (ptr == nullptr) {
+	return;
+      }
+      const auto * t = getTag (ptr);
+      auto& shard = _shards[t->shard];
+      auto * orig = reinterpret_cast<char *>(ptr) - t->offset;
+      std::lock_guard<LockType> l (shard.lock);
+      shard.heap.free (orig);
+    }
+
+    /// Allocate extra room, so that the object (and its tag just
+    /// before it) can sit alignment bytes in.
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (alignment <= (size_t) Alignment) {
+	return malloc (sz);
+      }
+      if (HL_EXPECT_FALSE(sz + alignment < sz)) HL_UNLIKELY {
+	return nullptr;
+      }
+      const auto s = preferredShard();
+      auto& shard = _shards[s];
+      std::lock_guard<LockType> l (shard.lock);
+      return tag (HL::memalign (shard.heap, alignment, sz + alignment), s, (unsigned int) alignment);
+    }
+
+    inline size_t getSize (void * ptr) {
+      const auto * t = getTag (ptr);
+      auto& shard = _shards[t->shard];
+      std::lock_guard<LockType> l (shard.lock);
+      return shard.heap.getSize (reinterpret_cast<char *>(ptr) - t->offset) - t->offset;
+    }
+
+    /// Size-class rounding is the same in every shard, so this takes no lock.
+    inline size_t good_size (size_t sz) {
+      return HL::good_size (_shards[0].heap, sz + HeaderSize) - HeaderSize;
+    }
+
+    inline bool try_resize (void * ptr, size_t sz) {
+      const auto * t = getTag (ptr);
+      auto& shard = _shards[t->shard];
+      std::lock_guard<LockType> l (shard.lock);
+      return HL::try_resize (shard.heap, reinterpret_cast<char *>(ptr) - t->offset, sz + t->offset);
+    }
+
+    inline size_t trim (size_t pad) {
+      size_t released = 0;
+      for (auto& shard : _shards) {
+	std::lock_guard<LockType> l (shard.lock);
+	released += HL::trim (shard.heap, pad);
+      }
+      return released;
+    }
+
+    inline void collect_stats (HeapStats& stats) {
+      for (auto& shard : _shards) {
+	std::lock_guard<LockType> l (shard.lock);
+	HL::collect_stats (shard.heap, stats);
+      }
+    }
+
+    /// Take every shard's lock (for fork).
+    inline void lock() {
+      for (auto& shard : _shards) {
+	shard.lock.lock();
+      }
+    }
+
+    inline void unlock() {
+      for (int i = N - 1; i >= 0; i--) {
+	_shards[i].lock.unlock();
+      }
+    }
+
+  private:
+
+    struct Tag {
+      uint32_t shard;
+      uint32_t offset;	///< From the start of the block to the object.
+    };
+
+    struct alignas(64) Shard {
+      LockType lock;
+      Heap heap;
+    };
+
+    static inline void * tag (void * block, unsigned int s, unsigned int offset) {
+      if (block == nullptr) {
+	return nullptr;
+      }
+      auto * ptr = reinterpret_cast<char *>(block) + offset;
+      auto * t = getTag (ptr);
+      t->shard = s;
+      t->offset = offset;
+      return ptr;
+    }
+
+    static inline Tag * getTag (void * ptr) {
+      return reinterpret_cast<Tag *>(ptr) - 1;
+    }
+
+    /// The shard this thread last got, or (at first) one picked by
+    /// thread index.
+    static inline unsigned int preferredShard() {
+      const auto last = _lastShard;
+      if (HL_EXPECT_TRUE(last != 0)) HL_LIKELY {
+	return last - 1;
+      }
+      return ThreadIndex::get() % (unsigned int) N;
+    }
+
+    Shard _shards[N];
+
+    /// One more than this thread's last shard (0 if none yet).
+#if defined(_WIN32)
+    static thread_local unsigned int _lastShard;
+#else
+    static __thread unsigned int _lastShard INITIAL_EXEC_ATTR;
+#endif
+  };
+
+#if defined(_WIN32)
+  template <int N, class LockType, class Heap>
+  thread_local unsigned int ShardedLockedHeap<N, LockType, Heap>::_lastShard = 0;
+#else
+  template <int N, class LockType, class Heap>
+  __thread unsigned int ShardedLockedHeap<N, LockType, Heap>::_lastShard = 0;
+#endif
+
+}
+
+#endif
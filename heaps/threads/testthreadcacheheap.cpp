@@ -0,0 +1,168 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+/*
+ * Runs several threads against one ThreadCacheHeap (over the shared
+ * heap libscalable uses), mixing malloc, calloc, realloc, memalign
+ * and free, with objects handed between threads. Every call that
+ * reaches the shared heap must take its lock; one that does not
+ * corrupts its free lists, which shows up as a crash or as an
+ * object whose contents changed under its owner.
+ *
+ *   g++ -std=c++14 -O2 -I../.. testthreadcacheheap.cpp -o testthreadcacheheap -lpthread
+ *   ./testthreadcacheheap [threads] [operations per thread]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+volatile int anyThreadCreated = 1;
+
+#include "heaplayers.h"
+
+using namespace HL;
+
+class TopHeap : public SizeHeap<ZoneHeap<SizedMmapHeap, 1048576>> {};
+
+class CentralHeap : public KingsleyHeap<AdaptHeap<DLList, TopHeap>, TopHeap> {};
+
+class TheHeap : public ANSIWrapper<ThreadCacheHeap<CentralHeap, SpinLock, 1024>> {};
+
+static TheHeap theHeap;
+
+enum { Slots = 1024 };
+
+struct Object {
+  unsigned char * ptr;
+  size_t size;
+  unsigned char fill;
+};
+
+// Objects left here by one thread are freed (or resized) by the next.
+static std::atomic<Object *> handoff[Slots];
+
+static bool holds (const Object& o, unsigned char fill, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (o.ptr[i] != fill) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void run (unsigned int seed, int ops, std::atomic<int> * bad) {
+  std::vector<Object> mine (Slots, Object { nullptr, 0, 0 });
+  for (int i = 0; i < ops; i++) {
+    seed = seed * 1103515245 + 12345;
+    auto& o = mine[(seed >> 8) % Slots];
+    const size_t sz = 1 + (seed >> 3) % ((seed & 0x10000) ? 8192 : 300);
+    if ((o.ptr != nullptr) && !holds (o, o.fill, o.size)) {
+      (*bad)++;
+    }
+    switch ((seed >> 20) % 5) {
+    case 0:
+      theHeap.free (o.ptr);
+      o.ptr = (unsigned char *) theHeap.malloc (sz);
+      break;
+    case 1:
+      theHeap.free (o.ptr);
+      o.ptr = (unsigned char *) theHeap.calloc (1, sz);
+      o.size = sz;
+      o.fill = 0;
+      if ((o.ptr == nullptr) || !holds (o, 0, sz)) {
+	(*bad)++;
+      }
+      break;
+    case 2:
+      {
+	auto * p = (unsigned char *) theHeap.realloc (o.ptr, sz);
+	o.size = (o.ptr == nullptr) ? 0 : ((o.size < sz) ? o.size : sz);
+	o.ptr = p;
+	if ((p == nullptr) || !holds (o, o.fill, o.size)) {
+	  (*bad)++;
+	}
+      }
+      break;
+    case 3:
+      {
+	const size_t alignment = (size_t) 32 << ((seed >> 4) % 8);
+	theHeap.free (o.ptr);
+	o.ptr = (unsigned char *) theHeap.memalign (alignment, sz);
+	if ((o.ptr == nullptr) || ((uintptr_t) o.ptr & (alignment - 1))) {
+	  (*bad)++;
+	}
+      }
+      break;
+    case 4:
+      // Swap with whatever another thread left.
+      {
+	auto * mineNow = new Object (o);
+	auto * theirs = handoff[(seed >> 12) % Slots].exchange (mineNow);
+	if (theirs != nullptr) {
+	  o = *theirs;
+	  delete theirs;
+	  continue;
+	}
+	o.ptr = nullptr;
+	continue;
+      }
+    }
+    if (o.ptr == nullptr) {
+      (*bad)++;
+      continue;
+    }
+    o.size = sz;
+    o.fill = (unsigned char) (seed >> 24);
+    memset (o.ptr, o.fill, sz);
+  }
+  for (auto& o : mine) {
+    theHeap.free (o.ptr);
+  }
+}
+
+int main (int argc, char * argv[]) {
+  const int nthreads = (argc > 1) ? atoi (argv[1]) : 4;
+  const int ops = (argc > 2) ? atoi (argv[2]) : 1000000;
+  std::atomic<int> bad (0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back (run, (unsigned int) t * 7919 + 1, ops, &bad);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (auto& h : handoff) {
+    if (Object * o = h.exchange (nullptr)) {
+      if (!holds (*o, o->fill, o->size)) {
+	bad++;
+      }
+      theHeap.free (o->ptr);
+      delete o;
+    }
+  }
+  if (bad != 0) {
+    printf ("FAILED: %d bad objects\n", bad.load());
+    return 1;
+  }
+  printf ("%d threads, %d operations each: ok\n", nthreads, ops);
+  return 0;
+}
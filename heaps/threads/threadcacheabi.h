@@ -0,0 +1,91 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_THREADCACHEABI_H
+#define HL_THREADCACHEABI_H
+
+/**
+ * @file threadcacheabi.h
+ * @brief The layout of a thread's cache, as shared with inline code.
+ *
+ * A ThreadCacheHeap built with Exported = true publishes the calling
+ * thread's cache lists in ExportedThreadCache<>::lists, an
+ * initial-exec TLS pointer, so that code compiled against
+ * wrappers/inlinealloc.h can pop and push them directly (see
+ * HL::allocate). Class c holds objects of at least
+ * ThreadCacheMinClassSize << c bytes, each freed back to the
+ * allocator's own free() when the cache gives it up. The pointer is
+ * null on threads whose cache is not set up yet (or is being torn
+ * down).
+ *
+ * A preloaded library cannot bind to a TLS variable in the program
+ * (programs do not export their symbols), nor the program to one in
+ * a library it was not linked with. So the allocator also exports
+ * HL_THREAD_CACHE_SLOT_FUNCTION, which returns the address of the
+ * calling thread's pointer; inline code looks it up once, and keeps
+ * the address in a TLS pointer of its own.
+ */
+
+namespace HL {
+
+  /// A free object in a cache list.
+  struct ThreadCacheEntry {
+    ThreadCacheEntry * next;
+  };
+
+  /// One size class of a thread's cache: a LIFO list, its length, and
+  /// the length past which free hands objects back (and any state the
+  /// allocator keeps alongside).
+  struct ThreadCacheList {
+    ThreadCacheEntry * head;
+    unsigned int count;
+    unsigned int limit;
+    unsigned int overflows;
+  };
+
+  /// The smallest class's object size (each class doubles it).
+  enum { ThreadCacheMinClassSize = 16 };
+
+  /// The number of classes an exported cache must provide (up to 2 KB).
+  enum { ThreadCacheExportedClasses = 8 };
+
+#if !defined(_WIN32)
+
+  /// The calling thread's exported lists (in the allocator).
+  template <int Dummy = 0>
+  struct ExportedThreadCache {
+    static __thread ThreadCacheList * lists __attribute__((tls_model ("initial-exec")));
+  };
+
+  template <int Dummy>
+  __thread ThreadCacheList * ExportedThreadCache<Dummy>::lists = nullptr;
+
+#endif
+
+}
+
+/// The name of the function (extern "C", taking no arguments) that
+/// returns the address of the calling thread's exported lists pointer.
+#define HL_THREAD_CACHE_SLOT_FUNCTION "xxmalloc_thread_cache_slot"
+
+/// Define that function in an allocator that exports its cache.
+#define HL_EXPORT_THREAD_CACHE_SLOT						\
+  extern "C" HL::ThreadCacheList ** xxmalloc_thread_cache_slot() {	\
+    return &HL::ExportedThreadCache<>::lists;				\
+  }
+
+#endif
@@ -0,0 +1,376 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_THREADCACHEHEAP_H
+#define HL_THREADCACHEHEAP_H
+
+#if !defined(_WIN32) // not implemented for Windows
+
+#include <cstddef>
+#include <mutex>
+
+#include <pthread.h>
+
+#include "heaps/threads/threadcacheabi.h"
+#include "locks/spinlock.h"
+#include "utility/cpp23compat.h"
+#include "utility/goodsize.h"
+#include "utility/heapstats.h"
+#include "utility/ilog2.h"
+#include "utility/memalign.h"
+#include "utility/trim.h"
+#include "utility/tryresize.h"
+#include "utility/zeromemory.h"
+
+/**
+ * @class ThreadCacheHeap
+ * @brief Small per-thread caches in front of one shared heap.
+ *
+ * Each thread keeps a bounded LIFO list of free objects for every
+ * power-of-two class up to MaxCachedSize, used without locking. An
+ * empty list is refilled with a batch of objects from Central, and a
+ * list that grows past its limit sends half of its objects back, in
+ * each case under a single hold of Central's lock. Limits adapt:
+ * a class that keeps running dry gets a longer list, while one that
+ * keeps overflowing (freed more than allocated on this thread) is
+ * cut back. A thread's lists go back to Central when it exits.
+ *
+ * Unlike ThreadSpecificHeap, threads share one heap, so the memory
+ * held beyond live objects stays bounded; unlike LockedHeap, most
+ * mallocs and frees never take the lock.
+ *
+ * Central is not locked by the caller (this layer locks it), but its
+ * getSize must be safe without the lock, as it is for heaps with
+ * object headers. Central is a private base, so that none of its
+ * methods can be reached without the lock; clear is not offered,
+ * since other threads' caches would still hold its objects. Each
+ * thread's caches belong to the heap type, so use a single instance
+ * (as with the other thread layers).
+ *
+ * With Exported set, each thread's lists are also published in
+ * ExportedThreadCache (see threadcacheabi.h), so that inline code
+ * (HL::allocate in wrappers/inlinealloc.h) can use the same cache
+ * without calling malloc. Only one heap in a process should export,
+ * and its library must define HL_EXPORT_THREAD_CACHE_SLOT.
+ *
+ * @param Central The shared heap (a segregated-fits heap, say).
+ * @param LockType The lock for Central.
+ * @param MaxCachedSize The largest cached object size (a power of two).
+ * @param Exported Whether to publish each thread's lists for inline code.
+ */
+
+namespace HL {
+
+  template <class Central,
+	    class LockType = SpinLock,
+	    size_t MaxCachedSize = 1024,
+	    bool Exported = false>
+  class ThreadCacheHeap : private Central {
+  public:
+
+    enum { Alignment = Central::Alignment };
+
+    enum { MinClassSize = ThreadCacheMinClassSize };
+    enum { NumClasses = ilog2 (MaxCachedSize) - ilog2 (MinClassSize) + 1 };
+
+    /// Bytes moved per refill (at least MinBatch objects, at most MaxBatch).
+    enum { BatchBytes = 4096, MinBatch = 2, MaxBatch = 32 };
+
+    /// Bytes one thread may cache per class.
+    enum { MaxBytesPerClass = 64 * 1024 };
+
+    static_assert ((MaxCachedSize & (MaxCachedSize - 1)) == 0,
+		   "MaxCachedSize must be a power of two.");
+    static_assert (MaxCachedSize >= MinClassSize,
+		   "MaxCachedSize must be at least MinClassSize.");
+    static_assert (!Exported || ((int) NumClasses >= (int) ThreadCacheExportedClasses),
+		   "An exported cache must cover the classes inline code uses.");
+
+    ~ThreadCacheHeap() {
+      if (Cache * c = cache) {
+	cache = nullptr;
+	publish (nullptr);
+	storage.exiting = true;
+	flush (c);
+      }
+    }
+
+    inline void * malloc (size_t sz) {
+      if (HL_EXPECT_TRUE(sz <= MaxCachedSize)) HL_LIKELY {
+	const int c = sizeClass (sz);
+	Cache * tc = cache;
+	if (HL_EXPECT_TRUE(tc != nullptr)) HL_LIKELY {
+	  auto& list = tc->lists[c];
+	  if (HL_EXPECT_TRUE(list.head != nullptr)) HL_LIKELY {
+	    auto * obj = list.head;
+	    list.head = obj->next;
+	    list.count--;
+	    return obj;
+	  }
+	}
+	return refill (c);
+      }
+      std::lock_guard<LockType> l (_lock);
+      return Central::malloc (sz);
+    }
+
+    inline void free (void * ptr) {
+      if (ptr == nullptr) {
+	return;
+      }
+      const size_t sz = Central::getSize (ptr);
+      Cache * tc = cache;
+      if (HL_EXPECT_TRUE((tc != nullptr) && (sz >= MinClassSize) && (sz <= MaxCachedSize))) HL_LIKELY {
+	// The largest class the object can hold.
+	const int c = (int) (floorLog2 (sz) - ilog2 (MinClassSize));
+	auto& list = tc->lists[c];
+	auto * obj = reinterpret_cast<Entry *>(ptr);
+	obj->next = list.head;
+	list.head = obj;
+	if (HL_EXPECT_FALSE(++list.count > list.limit)) HL_UNLIKELY {
+	  overflow (list, c);
+	}
+	return;
+      }
+      std::lock_guard<LockType> l (_lock);
+      Central::free (ptr);
+    }
+
+    /// Cached objects are not zero, so small ones are cleared here;
+    /// larger ones come from Central, which may know better.
+    inline void * malloc_zeroed (size_t sz) {
+      if (sz <= MaxCachedSize) {
+	void * ptr = malloc (sz);
+	if (ptr != nullptr) {
+	  bulk_zero (ptr, sz);
+	}
+	return ptr;
+      }
+      std::lock_guard<LockType> l (_lock);
+      return HL::malloc_zeroed (static_cast<Central&>(*this), sz);
+    }
+
+    inline void free_sized (void * ptr, size_t) {
+      free (ptr);
+    }
+
+    inline void free_aligned_sized (void * ptr, size_t, size_t) {
+      free (ptr);
+    }
+
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (alignment <= (size_t) Alignment) {
+	return malloc (sz);
+      }
+      std::lock_guard<LockType> l (_lock);
+      return HL::memalign (static_cast<Central&>(*this), alignment, sz);
+    }
+
+    inline size_t getSize (void * ptr) {
+      return Central::getSize (ptr);
+    }
+
+    /// Resize in Central. A cached-size object freed afterwards joins
+    /// the class its new size fits (free goes by size, not origin).
+    inline bool try_resize (void * ptr, size_t sz) {
+      std::lock_guard<LockType> l (_lock);
+      return HL::try_resize (static_cast<Central&>(*this), ptr, sz);
+    }
+
+    inline size_t good_size (size_t sz) {
+      if (sz <= MaxCachedSize) {
+	return classSize (sizeClass (sz));
+      }
+      return HL::good_size (static_cast<Central&>(*this), sz);
+    }
+
+    /// Return the calling thread's cached objects, then trim Central.
+    inline size_t trim (size_t pad) {
+      if (Cache * c = cache) {
+	flush (c);
+      }
+      std::lock_guard<LockType> l (_lock);
+      return HL::trim (static_cast<Central&>(*this), pad);
+    }
+
+    /// Report Central and the calling thread's cache.
+    inline void collect_stats (HeapStats& stats) {
+      if (Cache * c = cache) {
+	for (int i = 0; i < NumClasses; i++) {
+	  stats.threadCacheBytes += c->lists[i].count * classSize (i);
+	}
+      }
+      std::lock_guard<LockType> l (_lock);
+      HL::collect_stats (static_cast<Central&>(*this), stats);
+    }
+
+    inline void lock() {
+      _lock.lock();
+    }
+
+    inline void unlock() {
+      _lock.unlock();
+    }
+
+  private:
+
+    typedef ThreadCacheEntry Entry;
+    typedef ThreadCacheList FreeList;
+
+    struct Cache {
+      FreeList lists[NumClasses];
+      ThreadCacheHeap * owner;
+      bool exiting;
+    };
+
+    static inline int sizeClass (size_t sz) {
+      return (int) ilog2 ((sz < MinClassSize) ? (size_t) MinClassSize : sz) - (int) ilog2 (MinClassSize);
+    }
+
+    static inline size_t classSize (int c) {
+      return (size_t) MinClassSize << c;
+    }
+
+    static inline unsigned int floorLog2 (size_t sz) {
+      return (unsigned int) (sizeof(size_t) * 8 - 1) - (unsigned int) __builtin_clzl (sz);
+    }
+
+    static inline unsigned int batchSize (int c) {
+      const auto n = (unsigned int) (BatchBytes / classSize (c));
+      return (n < (unsigned int) MinBatch) ? (unsigned int) MinBatch : ((n > (unsigned int) MaxBatch) ? (unsigned int) MaxBatch : n);
+    }
+
+    static inline unsigned int maxLimit (int c) {
+      const auto n = (unsigned int) (MaxBytesPerClass / classSize (c));
+      return (n < batchSize (c)) ? batchSize (c) : n;
+    }
+
+    /// The list was empty: fetch a batch (and, since this class is
+    /// in demand, let its list grow).
+    void * refill (int c) {
+      Cache * tc = attach();
+      const auto sz = classSize (c);
+      if (tc == nullptr) {
+	std::lock_guard<LockType> l (_lock);
+	return Central::malloc (sz);
+      }
+      auto& list = tc->lists[c];
+      const auto batch = batchSize (c);
+      if (list.limit < maxLimit (c)) {
+	list.limit += batch;
+	if (list.limit > maxLimit (c)) {
+	  list.limit = maxLimit (c);
+	}
+      }
+      list.overflows = 0;
+      void * result;
+      {
+	std::lock_guard<LockType> l (_lock);
+	result = Central::malloc (sz);
+	for (unsigned int i = 1; (result != nullptr) && (i < batch); i++) {
+	  auto * obj = reinterpret_cast<Entry *>(Central::malloc (sz));
+	  if (obj == nullptr) {
+	    break;
+	  }
+	  obj->next = list.head;
+	  list.head = obj;
+	  list.count++;
+	}
+      }
+      return result;
+    }
+
+    /// The list is over its limit: send half back (and, if this keeps
+    /// happening without a refill in between, shorten it).
+    void overflow (FreeList& list, int c) {
+      const auto batch = batchSize (c);
+      if ((++list.overflows > 3) && (list.limit > batch)) {
+	list.limit -= batch;
+	list.overflows = 0;
+      }
+      release (list, list.count / 2);
+    }
+
+    /// Return n objects from the list to Central.
+    void release (FreeList& list, unsigned int n) {
+      std::lock_guard<LockType> l (_lock);
+      for (; (n > 0) && (list.head != nullptr); n--) {
+	auto * obj = list.head;
+	list.head = obj->next;
+	list.count--;
+	Central::free (obj);
+      }
+    }
+
+    void flush (Cache * tc) {
+      auto * owner = tc->owner;
+      for (auto& list : tc->lists) {
+	owner->release (list, list.count);
+      }
+    }
+
+    /// Set up the calling thread's cache (once), to be flushed when
+    /// the thread exits. Returns nullptr while the thread is exiting.
+    Cache * attach() {
+      if ((cache != nullptr) || storage.exiting) {
+	return cache;
+      }
+      storage.owner = this;
+      for (int c = 0; c < NumClasses; c++) {
+	storage.lists[c].limit = batchSize (c);
+      }
+      cache = &storage;
+      publish (storage.lists);
+      static pthread_key_t key;
+      static pthread_once_t once = PTHREAD_ONCE_INIT;
+      pthread_once (&once, [] { pthread_key_create (&key, detach); });
+      pthread_setspecific (key, &storage);
+      return cache;
+    }
+
+    static void detach (void *) {
+      cache = nullptr;
+      publish (nullptr);
+      storage.exiting = true;
+      storage.owner->flush (&storage);
+    }
+
+    static inline void publish (FreeList * lists) {
+      if (Exported) {
+	ExportedThreadCache<>::lists = lists;
+      }
+    }
+
+    HL_NO_UNIQUE_ADDRESS LockType _lock;
+
+    static __thread Cache * cache __attribute__((tls_model ("initial-exec")));
+    static __thread Cache storage __attribute__((tls_model ("initial-exec")));
+  };
+
+  template <class Central, class LockType, size_t MaxCachedSize, bool Exported>
+  __thread typename ThreadCacheHeap<Central, LockType, MaxCachedSize, Exported>::Cache *
+  ThreadCacheHeap<Central, LockType, MaxCachedSize, Exported>::cache = nullptr;
+
+  template <class Central, class LockType, size_t MaxCachedSize, bool Exported>
+  __thread typename ThreadCacheHeap<Central, LockType, MaxCachedSize, Exported>::Cache
+  ThreadCacheHeap<Central, LockType, MaxCachedSize, Exported>::storage = {};
+
+}
+
+#endif
+
+#endif
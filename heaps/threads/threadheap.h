@@ -21,7 +21,9 @@
 #include <assert.h>
 #include <new>
 
-#include "threads/cpuinfo.h"
+#include "threads/threadindex.h"
+#include "utility/modulo.h"
+#include "utility/tunables.h"
 
 #if !defined(_WIN32)
 #include <pthread.h>
@@ -31,10 +33,12 @@
 
   A ThreadHeap comprises NumHeaps "per-thread" heaps.
 
-  To pick a per-thread heap, the current thread id is hashed (mod NumHeaps).
+  To pick a per-thread heap, the current thread's index (see
+  ThreadIndex) is taken mod NumHeaps. Live threads have distinct,
+  dense indices, so up to NumHeaps threads each get a heap of their own.
 
-  malloc gets memory from its hashed per-thread heap.
-  free returns memory to its hashed per-thread heap.
+  malloc gets memory from its per-thread heap.
+  free returns memory to its per-thread heap.
 
   (This allows the per-thread heap to determine the return
   policy -- 'pure private heaps', 'private heaps with ownership',
@@ -51,29 +55,39 @@ namespace HL {
     enum { Alignment = PerThreadHeap::Alignment };
 
     inline void * malloc (size_t sz) {
-      auto tid = Modulo<NumHeaps>::mod (CPUInfo::getThreadId());
-      assert (tid >= 0);
-      assert (tid < NumHeaps);
+      auto tid = heapIndex();
       return getHeap(tid)->malloc (sz);
     }
 
     inline void free (void * ptr) {
-      auto tid = Modulo<NumHeaps>::mod (CPUInfo::getThreadId());
-      assert (tid >= 0);
-      assert (tid < NumHeaps);
+      auto tid = heapIndex();
       getHeap(tid)->free (ptr);
     }
 
     inline size_t getSize (void * ptr) {
-      auto tid = Modulo<NumHeaps>::mod (CPUInfo::getThreadId());
-      assert (tid >= 0);
-      assert (tid < NumHeaps);
+      auto tid = heapIndex();
       return getHeap(tid)->getSize (ptr);
     }
 
     
   private:
 
+    // Pick this thread's heap among the first NumHeaps (or fewer, if
+    // tuned down). Each thread keeps its own copy of the setting.
+    static inline unsigned int heapIndex() {
+#if defined(_WIN32)
+      static thread_local TunableCache<Tunables::ThreadHeaps> activeHeaps;
+#else
+      static __thread TunableCache<Tunables::ThreadHeaps> activeHeaps INITIAL_EXEC_ATTR;
+#endif
+      const auto id = ThreadIndex::get();
+      const auto n = activeHeaps.get (NumHeaps);
+      if (HL_EXPECT_TRUE(n >= (size_t) NumHeaps)) HL_LIKELY {
+	return Modulo<NumHeaps>::mod (id);
+      }
+      return (unsigned int) (id % n);
+    }
+
     // Access the given heap within the buffer.
     inline PerThreadHeap * getHeap (unsigned int index) {
       int ind = (int) index;
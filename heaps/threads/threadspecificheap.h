@@ -19,13 +19,23 @@
 */
 
 #include <assert.h>
+#include <cstddef>
 #include <new>
+#include <type_traits>
+#include <utility>
 
 #if !defined(_WIN32) // not implemented for Windows
 
 #include <pthread.h>
 
 #include "wrappers/mmapwrapper.h"
+#include "utility/cpp23compat.h"
+#include "utility/goodsize.h"
+#include "utility/heapstats.h"
+#include "utility/memalign.h"
+#include "utility/trim.h"
+#include "utility/tryresize.h"
+#include "utility/zeromemory.h"
 
 #if defined(__clang__)
 #pragma clang diagnostic push
@@ -49,16 +59,102 @@
 
 namespace HL {
 
+  namespace detail {
+
+    /**
+     * @class OrphanHeaps
+     * @brief Per-thread heaps whose threads have exited.
+     *
+     * An exiting thread parks its heap here, free lists and all, and
+     * the next new thread adopts it instead of starting from scratch,
+     * so memory cached by short-lived threads is not stranded. Heaps
+     * live in their own mappings (with a link in front) and are never
+     * destroyed.
+     */
+
+    template <class PerThreadHeap>
+    class OrphanHeaps {
+    public:
+
+      /// An orphaned heap if there is one; otherwise a fresh one.
+      static PerThreadHeap * adopt() {
+	pthread_mutex_lock (&getLock());
+	Slot * slot = getHead();
+	if (slot != nullptr) {
+	  getHead() = slot->next;
+	}
+	pthread_mutex_unlock (&getLock());
+	if (slot == nullptr) {
+	  void * buf = HL::MmapWrapper::map (sizeof(Slot));
+	  if (buf == nullptr) {
+	    return nullptr;
+	  }
+	  slot = new (buf) Slot;
+	  new (slot->buf) PerThreadHeap;
+	}
+	return reinterpret_cast<PerThreadHeap *>(slot->buf);
+      }
+
+      /// Keep a heap (from adopt) for a future thread.
+      static void park (PerThreadHeap * heap) {
+	auto * slot = reinterpret_cast<Slot *>(reinterpret_cast<char *>(heap) - offsetof(Slot, buf));
+	pthread_mutex_lock (&getLock());
+	slot->next = getHead();
+	getHead() = slot;
+	pthread_mutex_unlock (&getLock());
+      }
+
+      /// Report every parked heap (holding the lock, so that none is
+      /// adopted meanwhile).
+      static void collect_stats (HeapStats& stats) {
+	pthread_mutex_lock (&getLock());
+	for (auto * slot = getHead(); slot != nullptr; slot = slot->next) {
+	  HL::collect_stats (*reinterpret_cast<PerThreadHeap *>(slot->buf), stats);
+	}
+	pthread_mutex_unlock (&getLock());
+      }
+
+    private:
+
+      struct Slot {
+	Slot * next;
+	alignas(16) alignas(PerThreadHeap) char buf[sizeof(PerThreadHeap)];
+      };
+
+      static Slot *& getHead() {
+	static Slot * head = nullptr;
+	return head;
+      }
+
+      static pthread_mutex_t& getLock() {
+	static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	return lock;
+      }
+    };
+
+  }
+
 #if USE_THREAD_KEYWORD
 #if !defined(INITIAL_EXEC_ATTR)
 #define INITIAL_EXEC_ATTR __attribute__((tls_model ("initial-exec")))
 #endif
 
+  /**
+   * @class ThreadSpecificHeap
+   * @brief One PerThreadHeap per thread, reached through a TLS pointer.
+   *
+   * Each heap is mapped on its thread's first call (see OrphanHeaps),
+   * and a pthread key destructor parks it when the thread exits. It is
+   * never destroyed, since other threads may still hold objects it
+   * owns. A thread that calls in again after its heap was parked (from
+   * a later destructor, say) borrows a parked heap for just that call.
+   */
+
   template <class PerThreadHeap>
   class ThreadSpecificHeap {
   private:
-    alignas(16) static __thread char heapbuf[sizeof(PerThreadHeap)];
     static __thread PerThreadHeap * heap;
+    static __thread bool retired;
   public:
 
     ThreadSpecificHeap()
@@ -67,82 +163,150 @@ namespace HL {
 
     ~ThreadSpecificHeap() {
       if (heap) {
-	heap->~PerThreadHeap();
+	pthread_setspecific (getExitKey(), nullptr);
+	detach (heap);
       }
     }
     
     inline void * malloc(size_t sz) {
-      if (heap == nullptr) {
-	heap = new (heapbuf) PerThreadHeap();
-      }
-      return heap->malloc(sz);
+      return use([&](PerThreadHeap& h) { return h.malloc(sz); });
+    }
+
+    inline void * malloc_zeroed(size_t sz) {
+      return use([&](PerThreadHeap& h) { return HL::malloc_zeroed(h, sz); });
     }
     #if HL_USE_XXREALLOC
     inline void * realloc(void* ptr, size_t sz) {
-      if (heap == nullptr) {
-        heap = new (heapbuf) PerThreadHeap();
-      }
-      return heap->realloc(ptr, sz);
+      return use([&](PerThreadHeap& h) { return h.realloc(ptr, sz); });
     }
     #endif
 
     inline void free(void * ptr) {
-      if (heap == nullptr) {
-	heap = new (heapbuf) PerThreadHeap();
-      }
-      heap->free(ptr);
+      use([&](PerThreadHeap& h) { h.free(ptr); });
     }
 
     inline void free_sized(void * ptr, size_t sz) {
-      if (heap == nullptr) {
-	heap = new (heapbuf) PerThreadHeap();
-      }
-      heap->free_sized(ptr, sz);
+      use([&](PerThreadHeap& h) { h.free_sized(ptr, sz); });
     }
 
     inline void free_aligned_sized(void * ptr, size_t alignment, size_t sz) {
-      if (heap == nullptr) {
-	heap = new (heapbuf) PerThreadHeap();
-      }
-      heap->free_aligned_sized(ptr, alignment, sz);
+      use([&](PerThreadHeap& h) { h.free_aligned_sized(ptr, alignment, sz); });
     }
 
     inline void register_malloc(size_t sz, void * ptr) {
-      if (heap == nullptr) {
-	heap = new (heapbuf) PerThreadHeap();
-      }
-      heap->register_malloc(sz, ptr);
+      use([&](PerThreadHeap& h) { h.register_malloc(sz, ptr); });
     }
 
     inline void register_free(size_t sz, void * ptr) {
-      if (heap == nullptr) {
-	heap = new (heapbuf) PerThreadHeap();
-      }
-      heap->register_free(sz, ptr);
+      use([&](PerThreadHeap& h) { h.register_free(sz, ptr); });
     }
     
     inline void * memalign(size_t alignment, size_t sz) {
-      if (heap == nullptr) {
-	heap = new (heapbuf) PerThreadHeap();
-      }
-      return heap->memalign(alignment, sz);
+      return use([&](PerThreadHeap& h) { return HL::memalign(h, alignment, sz); });
+    }
+
+    inline size_t good_size(size_t sz) {
+      return use([&](PerThreadHeap& h) { return HL::good_size(h, sz); });
     }
     
     inline size_t getSize(void * ptr) {
+      return use([&](PerThreadHeap& h) { return h.getSize(ptr); });
+    }
+
+    inline bool try_resize(void * ptr, size_t sz) {
+      return use([&](PerThreadHeap& h) { return HL::try_resize(h, ptr, sz); });
+    }
+
+    /// Trim the calling thread's heap (other threads' heaps are theirs to trim).
+    inline size_t trim(size_t pad) {
       if (heap == nullptr) {
-	heap = new (heapbuf) PerThreadHeap();
+	return 0;
       }
-      return heap->getSize(ptr);
+      return HL::trim(*heap, pad);
+    }
+
+    /// Report the calling thread's heap and the parked ones. Other
+    /// live threads' heaps cannot be walked while their owners use
+    /// them, so what those cache is reported as in use.
+    inline void collect_stats(HeapStats& stats) {
+      if (heap != nullptr) {
+	HL::collect_stats(*heap, stats);
+      }
+      detail::OrphanHeaps<PerThreadHeap>::collect_stats(stats);
     }
 
     enum { Alignment = PerThreadHeap::Alignment };
+
+  private:
+
+    /// Apply op to the calling thread's heap. If no heap can be had
+    /// (the mapping failed), return op's failure value instead: null,
+    /// false or zero (free leaks its object).
+    template <class Op>
+    static inline auto use (Op op) -> decltype(op(std::declval<PerThreadHeap&>())) {
+      typedef decltype(op(std::declval<PerThreadHeap&>())) Result;
+      auto * h = heap;
+      if (HL_EXPECT_FALSE(h == nullptr)) HL_UNLIKELY {
+	if (retired) {
+	  return borrow (op);
+	}
+	h = attach();
+	if (h == nullptr) {
+	  return Result();
+	}
+      }
+      return op(*h);
+    }
+
+    /// The calling thread's first call: set up a heap and arrange to
+    /// park it on exit. Returns null (and tries again next call) if
+    /// there is no heap to be had.
+    __attribute__((noinline)) static PerThreadHeap * attach() {
+      // Publish the heap before registering it, since
+      // pthread_setspecific may itself call malloc.
+      heap = detail::OrphanHeaps<PerThreadHeap>::adopt();
+      if (heap != nullptr) {
+	pthread_setspecific (getExitKey(), heap);
+      }
+      return heap;
+    }
+
+    /// A call after the thread's heap was parked: there will be no
+    /// destructor to park another, so take a parked heap, use it, and
+    /// put it straight back.
+    template <class Op>
+    __attribute__((noinline)) static auto borrow (Op op) -> decltype(op(std::declval<PerThreadHeap&>())) {
+      typedef decltype(op(std::declval<PerThreadHeap&>())) Result;
+      auto * h = detail::OrphanHeaps<PerThreadHeap>::adopt();
+      if (h == nullptr) {
+	return Result();
+      }
+      struct Loan {
+	PerThreadHeap * h;
+	~Loan() { detail::OrphanHeaps<PerThreadHeap>::park (h); }
+      } loan { h };
+      return op(*h);
+    }
+
+    static void detach (void * h) {
+      heap = nullptr;
+      retired = true;
+      detail::OrphanHeaps<PerThreadHeap>::park (static_cast<PerThreadHeap *>(h));
+    }
+
+    static pthread_key_t getExitKey() {
+      static pthread_key_t key;
+      static pthread_once_t once = PTHREAD_ONCE_INIT;
+      pthread_once (&once, [] { pthread_key_create (&key, detach); });
+      return key;
+    }
   };
 
   template <class PerThreadHeap>
-  alignas(16) __thread char ThreadSpecificHeap<PerThreadHeap>::heapbuf[sizeof(PerThreadHeap)] INITIAL_EXEC_ATTR;
+  __thread PerThreadHeap * ThreadSpecificHeap<PerThreadHeap>::heap INITIAL_EXEC_ATTR = nullptr;
 
   template <class PerThreadHeap>
-  __thread PerThreadHeap * ThreadSpecificHeap<PerThreadHeap>::heap INITIAL_EXEC_ATTR = nullptr;
+  __thread bool ThreadSpecificHeap<PerThreadHeap>::retired INITIAL_EXEC_ATTR = false;
 
 
 #else // USE_THREAD_KEYWORD
@@ -160,6 +324,10 @@ namespace HL {
     inline void * malloc (size_t sz) {
       return getHeap()->malloc (sz);
     }
+
+    inline void * malloc_zeroed (size_t sz) {
+      return HL::malloc_zeroed (*getHeap(), sz);
+    }
     #if HL_USE_XXREALLOC
     inline void * realloc(void* ptr, size_t sz) {
       return getHeap()->realloc(ptr, sz);
@@ -190,8 +358,29 @@ namespace HL {
       return getHeap()->getSize(ptr);
     }
 
+    inline bool try_resize (void * ptr, size_t sz) {
+      return HL::try_resize(*getHeap(), ptr, sz);
+    }
+
+    /// Trim the calling thread's heap (other threads' heaps are theirs to trim).
+    inline size_t trim (size_t pad) {
+      return HL::trim(*getHeap(), pad);
+    }
+
+    /// Report the calling thread's heap and the parked ones. Other
+    /// live threads' heaps cannot be walked while their owners use
+    /// them, so what those cache is reported as in use.
+    inline void collect_stats (HeapStats& stats) {
+      HL::collect_stats(*getHeap(), stats);
+      detail::OrphanHeaps<PerThreadHeap>::collect_stats(stats);
+    }
+
     inline void * memalign(size_t alignment, size_t sz) {
-      return getHeap()->memalign(alignment, sz);
+      return HL::memalign(*getHeap(), alignment, sz);
+    }
+
+    inline size_t good_size(size_t sz) {
+      return HL::good_size(*getHeap(), sz);
     }
     
     enum { Alignment = PerThreadHeap::Alignment };
@@ -213,9 +402,9 @@ namespace HL {
       return initOnce;
     }
 
+    // Park the exiting thread's heap for the next new thread.
     static void deleteHeap (void * heap) {
-      ((PerThreadHeap *) heap)->~PerThreadHeap();
-      HL::MmapWrapper::unmap (heap, sizeof(PerThreadHeap));
+      detail::OrphanHeaps<PerThreadHeap>::park ((PerThreadHeap *) heap);
     }
 
     // Access the given heap.
@@ -223,10 +412,9 @@ namespace HL {
       PerThreadHeap * heap =
 	(PerThreadHeap *) pthread_getspecific (getHeapKey());
       if (heap == nullptr)  {
-	// Grab some memory from a source, initialize the heap inside,
-	// and store it in the thread-local area.
-	void * buf = HL::MmapWrapper::map (sizeof(PerThreadHeap));
-	heap = new (buf) PerThreadHeap;
+	// Adopt an orphaned heap (or make a new one) and store it in
+	// the thread-local area.
+	heap = detail::OrphanHeaps<PerThreadHeap>::adopt();
 	pthread_setspecific (getHeapKey(), (void *) heap);
       }
       return heap;
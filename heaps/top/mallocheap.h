@@ -51,6 +51,19 @@ namespace HL {
       return ::malloc (sz);
     }
   
+#if !defined(_WIN32)
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (alignment <= (size_t) Alignment) {
+	return ::malloc (sz);
+      }
+      void * ptr = nullptr;
+      if (::posix_memalign (&ptr, alignment, sz) != 0) {
+	return nullptr;
+      }
+      return ptr;
+    }
+#endif
+
     inline void free (void * ptr) {
       ::free (ptr);
     }
@@ -42,6 +42,7 @@
 #include "wrappers/mmapwrapper.h"
 #include "wrappers/stlallocator.h"
 #include "utility/cpp23compat.h"
+#include "utility/heapstats.h"
 
 #ifndef HL_MMAP_PROTECTION_MASK
 #if HL_EXECUTABLE_HEAP
@@ -72,8 +73,9 @@ namespace HL {
   class SizedMmapHeap {
   public:
 
-    /// All memory from here is zeroed.
+    /// All memory from here is zeroed, fresh anonymous pages.
     enum { ZeroMemory = 1 };
+    enum { PageBacked = 1 };
 
     enum { Alignment = MmapWrapper::Alignment };
 
@@ -135,7 +137,35 @@ namespace HL {
       }
       return ptr;
     }
+
+    /// Fresh mappings are already zero-filled.
+    static inline void * malloc_zeroed (size_t sz) {
+      return malloc (sz);
+    }
     
+    /// Map sz bytes on an alignment boundary: over-map, then unmap
+    /// the excess at either end, leaving an ordinary mapping.
+    static inline void * memalign (size_t alignment, size_t sz) {
+      if (alignment <= (size_t) CPUInfo::PageSize) {
+	return malloc (sz);
+      }
+      sz = (sz + CPUInfo::PageSize - 1) & (size_t) ~(CPUInfo::PageSize - 1);
+      const size_t mapSize = sz + alignment - CPUInfo::PageSize;
+      auto * ptr = (char *) malloc (mapSize);
+      if (ptr == nullptr) {
+	return nullptr;
+      }
+      auto * aligned = (char *) (((uintptr_t) ptr + alignment - 1) & ~(uintptr_t) (alignment - 1));
+      if (aligned > ptr) {
+	munmap (ptr, (size_t) (aligned - ptr));
+      }
+      auto * end = ptr + mapSize;
+      if (end > aligned + sz) {
+	munmap (aligned + sz, (size_t) (end - (aligned + sz)));
+      }
+      return aligned;
+    }
+
     static void free (void * ptr, size_t sz)
     {
       munmap (reinterpret_cast<char *>(ptr), sz);
@@ -179,6 +209,20 @@ namespace HL {
       return const_cast<void *>(ptr);
     }
 
+    inline void * malloc_zeroed (size_t sz) {
+      return malloc (sz);
+    }
+
+    inline void * memalign (size_t alignment, size_t sz) {
+      void * ptr = SizedMmapHeap::memalign (alignment, sz);
+      if (ptr != nullptr) {
+	MyMapLock.lock();
+	MyMap[ptr] = sz;
+	MyMapLock.unlock();
+      }
+      return ptr;
+    }
+
     inline size_t getSize (void * ptr) {
       MyMapLock.lock();
       size_t sz = MyMap[ptr];
@@ -189,9 +233,24 @@ namespace HL {
 #if 1
     void free (void * ptr, size_t sz) {
       SizedMmapHeap::free (ptr, sz);
+      MyMapLock.lock();
+      MyMap.erase (ptr);
+      MyMapLock.unlock();
     }
 #endif
 
+    /// Report the mappings we hold.
+    void collect_stats (HeapStats& stats) {
+      size_t bytes = 0;
+      MyMapLock.lock();
+      for (const auto& m : MyMap) {
+	bytes += m.second;
+      }
+      MyMapLock.unlock();
+      stats.directBytes += bytes;
+      stats.mmapBytes += bytes;
+    }
+
     inline void free (void * ptr) {
       assert (HL::bit_cast<uintptr_t>(ptr) % Alignment == 0);
       MyMapLock.lock();
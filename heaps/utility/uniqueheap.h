@@ -21,6 +21,14 @@
 #include <cstdlib>
 #include <new>
 
+#include "utility/clearbudget.h"
+#include "utility/goodsize.h"
+#include "utility/heapstats.h"
+#include "utility/memalign.h"
+#include "utility/trim.h"
+#include "utility/tryresize.h"
+#include "utility/zeromemory.h"
+
 /**
  *
  * @class UniqueHeap
@@ -36,6 +44,9 @@ namespace HL {
   public:
 
     enum { Alignment = SuperHeap::Alignment };
+    enum { FreeIsNoop = free_is_noop<SuperHeap>::value };
+    enum { ZeroMemory = zero_memory<SuperHeap>::value };
+    enum { PageBacked = page_backed<SuperHeap>::value };
 
     /**
      * Ensure that the super heap gets created,
@@ -71,6 +82,18 @@ namespace HL {
       return getSuperHeap()->malloc (sz);
     }
   
+    inline void * malloc_zeroed (size_t sz) {
+      return HL::malloc_zeroed (*getSuperHeap(), sz);
+    }
+
+    inline void * memalign (size_t alignment, size_t sz) {
+      return HL::memalign (*getSuperHeap(), alignment, sz);
+    }
+
+    inline size_t good_size (size_t sz) {
+      return HL::good_size (*getSuperHeap(), sz);
+    }
+
     inline void free (void * ptr) {
       getSuperHeap()->free (ptr);
     }
@@ -79,6 +102,21 @@ namespace HL {
       return getSuperHeap()->getSize (ptr);
     }
 
+    inline bool try_resize (void * ptr, size_t sz) {
+      return HL::try_resize (*getSuperHeap(), ptr, sz);
+    }
+
+    inline size_t trim (size_t pad) {
+      return HL::trim (*getSuperHeap(), pad);
+    }
+
+    /// Report the shared heap, unless it was already reported.
+    inline void collect_stats (HeapStats& stats) {
+      if (stats.firstVisit (getSuperHeap())) {
+	HL::collect_stats (*getSuperHeap(), stats);
+      }
+    }
+
     inline int remove (void * ptr) {
       return getSuperHeap()->remove (ptr);
     }
@@ -87,6 +125,18 @@ namespace HL {
       getSuperHeap()->clear();
     }
 
+    inline bool clear_step (ClearBudget& budget) {
+      return HL::clear_step (*getSuperHeap(), budget);
+    }
+
+    inline void lock() {
+      getSuperHeap()->lock();
+    }
+
+    inline void unlock() {
+      getSuperHeap()->unlock();
+    }
+
 #if 0
     inline int getAllocated() {
       return getSuperHeap()->getAllocated();
@@ -1,6 +1,9 @@
+#include "futexlock.h"
 #include "maclock.h"
+#include "mcslock.h"
 #include "posixlock.h"
 #include "recursivelock.h"
 #include "spinlock.h"
+#include "ticketlock.h"
 #include "winlock.h"
 
@@ -0,0 +1,44 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_CPURELAX_H
+#define HL_CPURELAX_H
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace HL {
+
+  /// A hint, inside a spin-wait loop, that this core is only waiting:
+  /// pause on x86 (yielding the pipeline to a sibling hyperthread and
+  /// avoiding a memory-order flush on exit), yield on Arm.
+  inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__ ("yield" ::: "memory");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+    __yield();
+#endif
+  }
+
+}
+
+#endif
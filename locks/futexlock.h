@@ -0,0 +1,123 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_FUTEXLOCK_H
+#define HL_FUTEXLOCK_H
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cstdint>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "locks/cpurelax.h"
+#include "utility/tunables.h"
+
+/**
+ * @class FutexLockType
+ * @brief An adaptive lock: spin briefly, then sleep on a Linux futex.
+ *
+ * A contended lock() first spins, with a pause (x86) or yield (Arm)
+ * hint on each turn, for about as long as recent acquisitions of this
+ * lock took (as glibc's adaptive mutexes do), capped by the
+ * futexlock.max_spin tunable. If the lock is still held, the thread
+ * sleeps in the kernel instead of burning its time slice. Sleepers
+ * are counted, so unlock() makes a system call only when one is
+ * waiting; an uncontended lock and unlock are an exchange and a
+ * store, as in SpinLockType.
+ *
+ * Linux only.
+ */
+
+namespace HL {
+
+  class FutexLockType {
+  public:
+
+    FutexLockType()
+      : _locked (0),
+	_sleepers (0),
+	_spin (0)
+    {}
+
+    inline void lock() {
+      if (_locked.exchange (1, std::memory_order_acquire) != 0) {
+	contendedLock();
+      }
+    }
+
+    inline bool try_lock() {
+      return (_locked.load (std::memory_order_relaxed) == 0)
+	&& (_locked.exchange (1, std::memory_order_acquire) == 0);
+    }
+
+    inline void unlock() {
+      // Sequentially consistent, so that either we see a new sleeper
+      // or it sees the lock free (before it sleeps).
+      _locked.store (0, std::memory_order_seq_cst);
+      if (_sleepers.load (std::memory_order_seq_cst) != 0) {
+	futex (FUTEX_WAKE_PRIVATE, 1);
+      }
+    }
+
+  private:
+
+    static_assert (sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+		   "A futex must be a plain 32-bit word.");
+
+    __attribute__((noinline))
+    void contendedLock() {
+      // Spin a little longer than it has recently taken to get the
+      // lock; a spin that runs out counts as the maximum.
+      const int spin = _spin.load (std::memory_order_relaxed);
+      const int maxSpin = (int) Tunables::get (Tunables::FutexMaxSpin);
+      const int limit = (2 * spin + 10 < maxSpin) ? 2 * spin + 10 : maxSpin;
+      for (int n = 0; n < limit; n++) {
+	cpuRelax();
+	if (try_lock()) {
+	  _spin.store (spin + (n - spin) / 8, std::memory_order_relaxed);
+	  return;
+	}
+      }
+      _spin.store (spin + (limit - spin) / 8, std::memory_order_relaxed);
+      _sleepers.fetch_add (1, std::memory_order_seq_cst);
+      while (_locked.exchange (1, std::memory_order_acquire) != 0) {
+	// Returns at once if the lock was released in the meantime.
+	futex (FUTEX_WAIT_PRIVATE, 1);
+      }
+      _sleepers.fetch_sub (1, std::memory_order_relaxed);
+    }
+
+    inline long futex (int op, uint32_t value) {
+      return syscall (SYS_futex, reinterpret_cast<uint32_t *>(&_locked), op, value, nullptr, nullptr, 0);
+    }
+
+    std::atomic<uint32_t> _locked;	///< The futex word: 1 if held.
+    std::atomic<uint32_t> _sleepers;	///< Threads in (or entering) FUTEX_WAIT.
+    std::atomic<int> _spin;		///< Recent spins to acquire (a running average).
+  };
+
+  typedef FutexLockType FutexLock;
+
+}
+
+#endif
+
+#endif
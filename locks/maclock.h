@@ -74,6 +74,14 @@ namespace HL {
 #endif
     }
 
+    inline bool try_lock() {
+#if USE_UNFAIR_LOCKS
+      return os_unfair_lock_trylock(&mutex);
+#else
+      return OSSpinLockTry (&mutex);
+#endif
+    }
+
   private:
 
 #if USE_UNFAIR_LOCKS
@@ -0,0 +1,184 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_MCSLOCK_H
+#define HL_MCSLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+#if !defined(_WIN32)
+#include <sched.h>
+#endif
+
+#if !defined(_WIN32) && !defined(INITIAL_EXEC_ATTR)
+#define INITIAL_EXEC_ATTR __attribute__((tls_model ("initial-exec")))
+#endif
+
+#include "locks/cpurelax.h"
+
+/**
+ * @class MCSLockType
+ * @brief A queue lock (Mellor-Crummey and Scott): each waiter spins on
+ * its own cache line, and the lock is granted in arrival order.
+ *
+ * With SpinLockType, every waiter polls the lock's one word, so each
+ * release sends that line to every waiting core at once. Here a
+ * waiter appends a node to a queue and polls only its node; the
+ * holder hands the lock to its successor by writing that node. Each
+ * handoff touches one other core, however many are waiting. That is
+ * the case for it over SpinLockType on a contended central heap, but
+ * it has not been measured on a multi-core machine (see testlocks);
+ * on one core, where holders are often preempted, it is slower.
+ *
+ * The nodes come from a small per-thread pool (so lock() needs no
+ * argument and the lock can serve as a LockType), which allows a
+ * thread to hold up to MaxHeld MCS locks at once, released in any
+ * order. Waiters yield after a while, since a preempted holder (or
+ * successor) stalls the whole queue.
+ */
+
+namespace HL {
+
+  class MCSLockType {
+  public:
+
+    /// How many MCS locks one thread may hold (or wait for) at a time.
+    enum { MaxHeld = 32 };
+
+    MCSLockType()
+      : _tail (nullptr),
+	_holder (nullptr)
+    {}
+
+    inline void lock() {
+      auto * node = acquireNode();
+      node->next.store (nullptr, std::memory_order_relaxed);
+      node->waiting.store (true, std::memory_order_relaxed);
+      auto * prev = _tail.exchange (node, std::memory_order_acq_rel);
+      if (prev != nullptr) {
+	prev->next.store (node, std::memory_order_release);
+	waitWhile ([node] { return node->waiting.load (std::memory_order_acquire); });
+      }
+      _holder = node;
+    }
+
+    inline bool try_lock() {
+      if (_tail.load (std::memory_order_relaxed) != nullptr) {
+	return false;
+      }
+      auto * node = acquireNode();
+      node->next.store (nullptr, std::memory_order_relaxed);
+      Node * expected = nullptr;
+      if (_tail.compare_exchange_strong (expected, node, std::memory_order_acquire, std::memory_order_relaxed)) {
+	_holder = node;
+	return true;
+      }
+      releaseNode (node);
+      return false;
+    }
+
+    inline void unlock() {
+      auto * node = _holder;
+      auto * next = node->next.load (std::memory_order_acquire);
+      if (next == nullptr) {
+	// No successor yet: either there is none (so empty the queue) or
+	// one is between joining the queue and linking itself in.
+	auto * expected = node;
+	if (_tail.compare_exchange_strong (expected, nullptr, std::memory_order_release, std::memory_order_relaxed)) {
+	  releaseNode (node);
+	  return;
+	}
+	waitWhile ([node, &next] { return (next = node->next.load (std::memory_order_acquire)) == nullptr; });
+      }
+      next->waiting.store (false, std::memory_order_release);
+      releaseNode (node);
+    }
+
+  private:
+
+    // Initialized members keep the pool constant-initialized, so that
+    // it needs no guard (and stays initial-exec) as TLS.
+    struct alignas(64) Node {
+      std::atomic<Node *> next { nullptr };
+      std::atomic<bool> waiting { false };
+      unsigned int index = 0;
+    };
+
+    struct Pool {
+      Node nodes[MaxHeld];
+      uint32_t inUse = 0;	///< A bit per node.
+    };
+
+    static inline Pool& pool() {
+#if defined(_WIN32)
+      static thread_local Pool thePool;
+#else
+      static __thread Pool thePool INITIAL_EXEC_ATTR;
+#endif
+      return thePool;
+    }
+
+    static inline Node * acquireNode() {
+      auto& p = pool();
+      for (unsigned int i = 0; i < MaxHeld; i++) {
+	if ((p.inUse & (1U << i)) == 0) {
+	  p.inUse |= (1U << i);
+	  p.nodes[i].index = i;
+	  return &p.nodes[i];
+	}
+      }
+      // Holding MaxHeld locks at once: surely a bug.
+      abort();
+    }
+
+    static inline void releaseNode (Node * node) {
+      pool().inUse &= ~(1U << node->index);
+    }
+
+    template <class Condition>
+    static inline void waitWhile (Condition condition) {
+      unsigned int spins = 0;
+      while (condition()) {
+	cpuRelax();
+	if (++spins == YieldAfter) {
+	  spins = 0;
+#if !defined(_WIN32)
+	  sched_yield();
+#endif
+	}
+      }
+    }
+
+    enum { YieldAfter = 128 };
+
+    static_assert (MaxHeld <= 32, "Too many nodes for the pool's mask.");
+
+    alignas(64) std::atomic<Node *> _tail;
+
+    /// Written and read only by the holder. It has its own line, so
+    /// that arriving waiters' exchanges on _tail do not take it away
+    /// from the holder.
+    alignas(64) Node * _holder;
+  };
+
+  typedef MCSLockType MCSLock;
+
+}
+
+#endif
@@ -52,6 +52,10 @@ namespace HL {
     void unlock (void) {
       pthread_mutex_unlock (&mutex);
     }
+
+    bool try_lock (void) {
+      return pthread_mutex_trylock (&mutex) == 0;
+    }
   
   private:
     union {
@@ -49,6 +49,20 @@ namespace HL {
       }
     }
 
+    inline bool try_lock() {
+      auto currthread = (int) CPUInfo::getThreadId();
+      if (_tid == currthread) {
+	_recursiveDepth++;
+	return true;
+      }
+      if (!BaseLock::try_lock()) {
+	return false;
+      }
+      _tid = currthread;
+      _recursiveDepth++;
+      return true;
+    }
+
     inline void unlock (void) {
       auto currthread = (int) CPUInfo::getThreadId();
       if (_tid == currthread) {
@@ -33,6 +33,7 @@
 #endif
 
 #include "threads/cpuinfo.h"
+#include "utility/tunables.h"
 
 #if defined(_MSC_VER)
 
@@ -114,6 +115,13 @@ namespace HL {
       return !_mutex.exchange(true, std::memory_order_acquire);
     }
 
+    /// Take the lock only if it is free (so that std::unique_lock
+    /// with std::try_to_lock works).
+    inline bool try_lock() {
+      // Test first, so that failed attempts do not take the line.
+      return !_mutex.load(std::memory_order_relaxed) && didLock();
+    }
+
     inline void unlock() {
       // Release semantics: operations before unlock() cannot be reordered after
       _mutex.store(false, std::memory_order_release);
@@ -123,12 +131,12 @@ namespace HL {
 
     NO_INLINE
     void contendedLock() {
-      const int MAX_SPIN = 1000;
+      const auto MAX_SPIN = Tunables::get (Tunables::SpinCount);
       while (true) {
 	if (!_mutex.exchange(true, std::memory_order_acquire)) {
 	  return;
 	}
-	int count = 0;
+	size_t count = 0;
 	// Relaxed load for spinning - we'll acquire on the exchange
 	while (_mutex.load(std::memory_order_relaxed) && (count < MAX_SPIN)) {
 	  _MM_PAUSE;
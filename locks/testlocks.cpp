@@ -0,0 +1,143 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+/*
+ * Compares the lock types under contention. Each of T threads
+ * repeatedly takes one lock, either around a few counter updates
+ * (a short critical section) or around malloc and free on a shared
+ * LockedHeap (a central heap), and the time per acquisition is
+ * reported. It also checks that no update was lost.
+ *
+ *   g++ -std=c++14 -O2 -I.. testlocks.cpp -o testlocks -lpthread
+ *   ./testlocks [threads] [acquisitions per thread]
+ *
+ * Run with more threads than cores to see how each lock copes with
+ * preempted holders. Whether MCSLock or TicketLock beats SpinLock on
+ * a contended central heap depends on the core count; so far this
+ * has only been run on a single core, where the FIFO locks are the
+ * slowest (each preempted holder or successor stalls the queue).
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "heaps/buildingblock/freelistheap.h"
+#include "heaps/combining/strictsegheap.h"
+#include "heaps/general/kingsleyheap.h"
+#include "heaps/objectrep/sizeheap.h"
+#include "heaps/threads/lockedheap.h"
+#include "heaps/top/mmapheap.h"
+#include "locks/mcslock.h"
+#include "locks/posixlock.h"
+#include "locks/recursivelock.h"
+#include "locks/spinlock.h"
+#include "locks/ticketlock.h"
+#if defined(__linux__)
+#include "locks/futexlock.h"
+#endif
+#include "utility/timer.h"
+
+static int Threads = 8;
+static long Acquisitions = 200000;
+
+template <class LockType>
+static void critical (const char * name) {
+  LockType lock;
+  // A few lines of data, as a heap's free lists would be.
+  static long counters[4 * 8];
+  for (auto& c : counters) {
+    c = 0;
+  }
+  HL::Timer t;
+  t.start();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < Threads; i++) {
+    threads.emplace_back ([&] {
+      for (long j = 0; j < Acquisitions; j++) {
+	std::lock_guard<LockType> l (lock);
+	for (int k = 0; k < 4; k++) {
+	  counters[k * 8]++;
+	}
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  t.stop();
+  const bool ok = (counters[0] == Threads * Acquisitions);
+  printf ("%-24s critical   %8.1f ns/acquire%s\n", name,
+	  1e9 * (double) t / (Threads * Acquisitions), ok ? "" : "  LOST UPDATES");
+}
+
+template <class LockType>
+static void central (const char * name) {
+  typedef HL::LockedHeap<LockType, HL::KingsleyHeap<HL::FreelistHeap<HL::SizeHeap<HL::MmapHeap>>, HL::MmapHeap>> Heap;
+  alignas(64) static char buf[sizeof(Heap)];
+  static Heap * heap = new (buf) Heap;
+  HL::Timer t;
+  t.start();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < Threads; i++) {
+    threads.emplace_back ([&] {
+      void * objs[8];
+      for (long j = 0; j < Acquisitions / 8; j++) {
+	for (int k = 0; k < 8; k++) {
+	  objs[k] = heap->malloc (16 + 16 * (size_t) k);
+	}
+	for (int k = 0; k < 8; k++) {
+	  heap->free (objs[k]);
+	}
+      }
+    });
+  }
+  for (auto& th : threads) {
+    th.join();
+  }
+  t.stop();
+  printf ("%-24s LockedHeap %8.1f ns/acquire\n", name,
+	  1e9 * (double) t / (Threads * (Acquisitions / 8) * 16));
+}
+
+template <class LockType>
+static void run (const char * name) {
+  critical<LockType> (name);
+  central<LockType> (name);
+}
+
+int main (int argc, char * argv[]) {
+  if (argc > 1) {
+    Threads = atoi (argv[1]);
+  }
+  if (argc > 2) {
+    Acquisitions = atol (argv[2]);
+  }
+  printf ("%d threads, %ld acquisitions each\n", Threads, Acquisitions);
+  run<HL::SpinLock> ("SpinLock");
+  run<HL::PosixLock> ("PosixLock");
+#if defined(__linux__)
+  run<HL::FutexLock> ("FutexLock");
+#endif
+  run<HL::TicketLock> ("TicketLock");
+  run<HL::MCSLock> ("MCSLock");
+  run<HL::RecursiveLockType<HL::MCSLock>> ("RecursiveLock<MCSLock>");
+  return 0;
+}
@@ -0,0 +1,96 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_TICKETLOCK_H
+#define HL_TICKETLOCK_H
+
+#include <atomic>
+#include <cstdint>
+
+#if !defined(_WIN32)
+#include <sched.h>
+#endif
+
+#include "locks/cpurelax.h"
+
+/**
+ * @class TicketLockType
+ * @brief A fair spin lock: threads take a ticket and enter in order.
+ *
+ * Cheaper than MCSLockType when held only briefly (lock and unlock
+ * are one atomic add and one store, with no per-thread state), but
+ * all waiters still read one line. To keep that traffic down, each
+ * waiter pauses in proportion to its place in line before looking
+ * again. As with any FIFO lock, a preempted holder stalls everyone
+ * behind it, so waiters yield after a while.
+ */
+
+namespace HL {
+
+  class TicketLockType {
+  public:
+
+    TicketLockType()
+      : _next (0),
+	_serving (0)
+    {}
+
+    inline void lock() {
+      const auto ticket = _next.fetch_add (1, std::memory_order_relaxed);
+      auto serving = _serving.load (std::memory_order_acquire);
+      if (serving == ticket) {
+	return;
+      }
+      unsigned int spins = 0;
+      do {
+	for (auto ahead = ticket - serving; ahead > 0; ahead--) {
+	  cpuRelax();
+	}
+	if (++spins == YieldAfter) {
+	  spins = 0;
+#if !defined(_WIN32)
+	  sched_yield();
+#endif
+	}
+	serving = _serving.load (std::memory_order_acquire);
+      } while (serving != ticket);
+    }
+
+    inline bool try_lock() {
+      auto serving = _serving.load (std::memory_order_relaxed);
+      auto expected = serving;
+      return _next.compare_exchange_strong (expected, serving + 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    inline void unlock() {
+      // Only the holder writes _serving.
+      _serving.store (_serving.load (std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+  private:
+
+    enum { YieldAfter = 128 };
+
+    alignas(64) std::atomic<uint32_t> _next;
+    std::atomic<uint32_t> _serving;
+  };
+
+  typedef TicketLockType TicketLock;
+
+}
+
+#endif
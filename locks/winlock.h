@@ -59,6 +59,10 @@ namespace HL {
       // InterlockedExchange (&mutex, 0);
     }
 
+    inline bool try_lock (void) {
+      return InterlockedExchange ((long *) &mutex, 1) == 0;
+    }
+
   private:
     unsigned int mutex;
     bool onMultiprocessor (void) {
@@ -1,2 +1,4 @@
 #include "cpuinfo.h"
 #include "fred.h"
+#include "rseq.h"
+#include "threadindex.h"
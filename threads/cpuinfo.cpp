@@ -1,30 +1,55 @@
-// Unit test for CPUInfo.
+// Unit test for CPUInfo and ThreadIndex.
 
 #include "cpuinfo.h"
 #include "fred.h"
+#include "threadindex.h"
 
+#include <atomic>
 #include <iostream>
 
 const int NUMTHREADS = 256;
 
-/// A counter array. We use this to check that CPUInfo is evenly
-/// distributing thread ids.
-int counter[NUMTHREADS];
+/// Counter arrays. We use these to check how evenly thread ids and
+/// thread indices spread over NUMTHREADS buckets.
+int idCounter[NUMTHREADS];
+int indexCounter[NUMTHREADS];
+
+/// Every thread waits here until all have started, so that all are
+/// alive at once (otherwise exited threads' stacks and indices would
+/// simply be reused).
+std::atomic<int> arrived (0);
 
 using namespace HL;
 using namespace std;
 
 void * fn (void *) {
-  counter[CPUInfo::getThreadId() % NUMTHREADS]++;
+  const auto id = CPUInfo::getThreadId();
+  const auto index = ThreadIndex::get();
+  arrived++;
+  while (arrived.load() < NUMTHREADS) {
+    Fred::yield();
+  }
+  __atomic_fetch_add (&idCounter[id % NUMTHREADS], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add (&indexCounter[index % NUMTHREADS], 1, __ATOMIC_RELAXED);
   return NULL;
 }
 
+static int maxCount (const int * counter) {
+  int m = 0;
+  for (int i = 0; i < NUMTHREADS; i++) {
+    if (counter[i] > m) {
+      m = counter[i];
+    }
+  }
+  return m;
+}
+
 int
 main()
 {
-  // Clear the counter array.
+  // Clear the counter arrays.
   for (int i = 0; i < NUMTHREADS; i++) {
-    counter[i] = 0;
+    idCounter[i] = indexCounter[i] = 0;
   }
 
   Fred t[NUMTHREADS];
@@ -35,14 +60,8 @@ main()
     t[i].join();
   }
 
-  // Now check the counter array.
-  int maxCount = 0;
-  for (int i = 0; i < NUMTHREADS; i++) {
-    if (counter[i] > maxCount) {
-      maxCount = counter[i];
-    }
-  }
-
-  cout << "Maximum entries (should be near 1): " << maxCount << endl;
-  return 0;
+  // Now check the counter arrays.
+  cout << "Maximum thread ids per bucket (should be near 1): " << maxCount (idCounter) << endl;
+  cout << "Maximum thread indices per bucket (must be 1): " << maxCount (indexCounter) << endl;
+  return (maxCount (indexCounter) == 1) ? 0 : 1;
 }
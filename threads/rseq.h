@@ -0,0 +1,247 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_RSEQ_H
+#define HL_RSEQ_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "utility/cpp23compat.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#if defined(__linux__) && defined(__x86_64__) && defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#if defined(RSEQ_SIG)
+#define HL_HAVE_RSEQ 1
+#endif
+#endif
+#endif
+
+#if !defined(HL_HAVE_RSEQ)
+#define HL_HAVE_RSEQ 0
+#endif
+
+#define HL_RSEQ_STR(x) #x
+#define HL_RSEQ_STRINGIFY(x) HL_RSEQ_STR(x)
+
+/**
+ * @file rseq.h
+ * @brief The current CPU, and per-CPU list operations without atomics.
+ *
+ * On Linux, glibc (2.35 and later) registers a restartable-sequence
+ * area for every thread. The kernel keeps its cpu_id current, so
+ * reading the CPU is a TLS load, and it aborts any registered
+ * critical section that is preempted, migrated or interrupted by a
+ * signal before its final (commit) store. A per-CPU list can thus be
+ * pushed and popped with plain loads and stores: no other thread can
+ * run on that CPU in the middle, and no other CPU ever touches it.
+ *
+ * The critical sections are x86-64 assembly. Elsewhere, or when glibc
+ * did not register rseq (say, GLIBC_TUNABLES=glibc.pthread.rseq=0),
+ * available() is false and currentCPU() falls back to sched_getcpu.
+ */
+
+namespace HL {
+
+  class RSeq {
+  public:
+
+    /// Results of push and pop.
+    enum Status { Done = 0, Aborted = 1, Full = 2 };
+
+    /// A free object on a per-CPU list.
+    struct Node {
+      Node * next;
+      size_t depth;	///< Length of the list from here down.
+    };
+
+#if HL_HAVE_RSEQ
+
+    /// True if this thread can use the critical sections below.
+    static inline bool available() {
+      return (__rseq_size > 0) && ((int) area()->cpu_id >= 0);
+    }
+
+    /// The current CPU if this thread can use the critical sections
+    /// below; otherwise -1.
+    static inline int rseqCPU() {
+      if (HL_EXPECT_FALSE(__rseq_size == 0)) HL_UNLIKELY {
+	return -1;
+      }
+      return (int) __atomic_load_n (&area()->cpu_id, __ATOMIC_RELAXED);
+    }
+
+    static inline unsigned int currentCPU() {
+      if (HL_EXPECT_TRUE(__rseq_size > 0)) HL_LIKELY {
+	const int cpu = (int) __atomic_load_n (&area()->cpu_id, __ATOMIC_RELAXED);
+	if (HL_EXPECT_TRUE(cpu >= 0)) HL_LIKELY {
+	  return (unsigned int) cpu;
+	}
+      }
+      return fallbackCPU();
+    }
+
+    /**
+     * If this thread is still on cpu, pop the head of *head into
+     * result (nullptr if the list is empty). Returns Aborted if the
+     * thread was moved or interrupted (nothing happened), else Done.
+     */
+    static inline Status pop (Node ** head, unsigned int cpu, Node *& result) {
+      auto * rs = area();
+      Node * obj;
+      int status;
+      __asm__ __volatile__ (
+	".pushsection __rseq_cs, \"aw\"\n\t"
+	".balign 32\n\t"
+	"3:\n\t"
+	".long 0x0, 0x0\n\t"
+	".quad 1f, (2f - 1f), 4f\n\t"
+	".popsection\n\t"
+	"leaq 3b(%%rip), %%rax\n\t"
+	"movq %%rax, %[rseq_cs]\n\t"
+	"1:\n\t"
+	"cmpl %[cpu], %[cpu_id]\n\t"
+	"jnz 4f\n\t"
+	"movq (%[head]), %[obj]\n\t"
+	"testq %[obj], %[obj]\n\t"
+	"jz 2f\n\t"
+	"movq (%[obj]), %%rax\n\t"
+	"movq %%rax, (%[head])\n\t"	// commit
+	"2:\n\t"
+	"xorl %[status], %[status]\n\t"
+	"jmp 5f\n\t"
+	".pushsection __rseq_failure, \"ax\"\n\t"
+	".long " HL_RSEQ_STRINGIFY(RSEQ_SIG) "\n\t"
+	"4:\n\t"
+	"movl $1, %[status]\n\t"
+	"jmp 5f\n\t"
+	".popsection\n\t"
+	"5:\n\t"
+	: [obj] "=&r" (obj), [status] "=&r" (status)
+	: [head] "r" (head), [cpu] "r" (cpu),
+	  [cpu_id] "m" (rs->cpu_id), [rseq_cs] "m" (rs->rseq_cs)
+	: "rax", "memory", "cc");
+      result = obj;
+      return (Status) status;
+    }
+
+    /**
+     * If this thread is still on cpu, push obj onto *head, unless the
+     * list already holds maxDepth objects (Full). Returns Aborted if
+     * the thread was moved or interrupted (nothing happened).
+     */
+    static inline Status push (Node ** head, unsigned int cpu, Node * obj, size_t maxDepth) {
+      auto * rs = area();
+      int status;
+      __asm__ __volatile__ (
+	".pushsection __rseq_cs, \"aw\"\n\t"
+	".balign 32\n\t"
+	"3:\n\t"
+	".long 0x0, 0x0\n\t"
+	".quad 1f, (2f - 1f), 4f\n\t"
+	".popsection\n\t"
+	"leaq 3b(%%rip), %%rax\n\t"
+	"movq %%rax, %[rseq_cs]\n\t"
+	"1:\n\t"
+	"cmpl %[cpu], %[cpu_id]\n\t"
+	"jnz 4f\n\t"
+	"movq (%[head]), %%rax\n\t"
+	"movl $1, %%edx\n\t"
+	"testq %%rax, %%rax\n\t"
+	"jz 6f\n\t"
+	"movq 8(%%rax), %%rdx\n\t"
+	"addq $1, %%rdx\n\t"
+	"cmpq %[max], %%rdx\n\t"
+	"ja 7f\n\t"
+	"6:\n\t"
+	"movq %%rax, (%[obj])\n\t"
+	"movq %%rdx, 8(%[obj])\n\t"
+	"movq %[obj], (%[head])\n\t"	// commit
+	"2:\n\t"
+	"xorl %[status], %[status]\n\t"
+	"jmp 5f\n\t"
+	"7:\n\t"
+	"movl $2, %[status]\n\t"
+	"jmp 5f\n\t"
+	".pushsection __rseq_failure, \"ax\"\n\t"
+	".long " HL_RSEQ_STRINGIFY(RSEQ_SIG) "\n\t"
+	"4:\n\t"
+	"movl $1, %[status]\n\t"
+	"jmp 5f\n\t"
+	".popsection\n\t"
+	"5:\n\t"
+	: [status] "=&r" (status)
+	: [head] "r" (head), [cpu] "r" (cpu), [obj] "r" (obj), [max] "r" (maxDepth),
+	  [cpu_id] "m" (rs->cpu_id), [rseq_cs] "m" (rs->rseq_cs)
+	: "rax", "rdx", "memory", "cc");
+      return (Status) status;
+    }
+
+  private:
+
+    static inline struct rseq * area() {
+      char * tp;
+      __asm__ ("movq %%fs:0, %0" : "=r" (tp));
+      return reinterpret_cast<struct rseq *>(tp + __rseq_offset);
+    }
+
+#else
+
+    static inline bool available() {
+      return false;
+    }
+
+    static inline int rseqCPU() {
+      return -1;
+    }
+
+    static inline unsigned int currentCPU() {
+      return fallbackCPU();
+    }
+
+    static inline Status pop (Node **, unsigned int, Node *& result) {
+      result = nullptr;
+      return Aborted;
+    }
+
+    static inline Status push (Node **, unsigned int, Node *, size_t) {
+      return Aborted;
+    }
+
+  private:
+
+#endif
+
+    static inline unsigned int fallbackCPU() {
+#if defined(__linux__)
+      const int cpu = sched_getcpu();
+      return (cpu >= 0) ? (unsigned int) cpu : 0;
+#else
+      return 0;
+#endif
+    }
+
+  };
+
+}
+
+#endif
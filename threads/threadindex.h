@@ -0,0 +1,166 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_THREADINDEX_H
+#define HL_THREADINDEX_H
+
+#include <atomic>
+#include <cstdint>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+#include "utility/cpp23compat.h"
+
+#if !defined(_WIN32) && !defined(INITIAL_EXEC_ATTR)
+#define INITIAL_EXEC_ATTR __attribute__((tls_model ("initial-exec")))
+#endif
+
+/**
+ * @class ThreadIndex
+ * @brief Small, dense per-thread numbers, recycled when threads exit.
+ *
+ * CPUInfo::getThreadId() is derived from the thread's handle (on
+ * Linux, its stack address), and stacks sit at large, regular
+ * strides, so ids taken modulo a number of heaps pile up in a few
+ * buckets. ThreadIndex::get() instead gives each live thread the
+ * lowest number no other live thread holds: N threads get 0..N-1,
+ * and so map one-to-one onto N heaps. The number is assigned on first
+ * use (one TLS load after that) and freed when the thread exits, for
+ * the next new thread to take.
+ *
+ * Up to MaxRecycled numbers are recycled; should more threads than
+ * that be alive at once, the rest get fresh numbers from a counter.
+ * Nothing here allocates, so it is safe to call from inside malloc.
+ */
+
+namespace HL {
+
+  class ThreadIndex {
+  public:
+
+    enum { MaxRecycled = 4096 };
+
+    /// The calling thread's index.
+    static inline unsigned int get() {
+      const auto i = slot();
+      if (HL_EXPECT_TRUE(i != 0)) HL_LIKELY {
+	return i - 1;
+      }
+      return assign();
+    }
+
+  private:
+
+    enum { BitsPerWord = 64 };
+    enum { Words = (int) MaxRecycled / (int) BitsPerWord };
+
+    /// One more than the thread's index (0 if none yet). This is an
+    /// initial-exec __thread variable, so that reaching it is one
+    /// load even from a shared library.
+    static inline unsigned int& slot() {
+#if defined(_WIN32)
+      static thread_local unsigned int theSlot;
+#else
+      static __thread unsigned int theSlot INITIAL_EXEC_ATTR;
+#endif
+      return theSlot;
+    }
+
+    /// A bit for each recycled index, set while some thread holds it.
+    static inline std::atomic<uint64_t> * inUse() {
+      static std::atomic<uint64_t> theBits[Words];
+      return theBits;
+    }
+
+    static inline std::atomic<unsigned int>& overflow() {
+      static std::atomic<unsigned int> theCount (0);
+      return theCount;
+    }
+
+    static unsigned int assign() {
+      const auto index = acquire();
+      slot() = index + 1;
+      registerExit (index);
+      return index;
+    }
+
+    static unsigned int acquire() {
+      auto * words = inUse();
+      for (unsigned int w = 0; w < Words; w++) {
+	auto bits = words[w].load (std::memory_order_relaxed);
+	while (bits != ~(uint64_t) 0) {
+	  unsigned int b = 0;
+	  while (bits & ((uint64_t) 1 << b)) {
+	    b++;
+	  }
+	  if (words[w].compare_exchange_weak (bits, bits | ((uint64_t) 1 << b),
+					      std::memory_order_acquire,
+					      std::memory_order_relaxed)) {
+	    return w * BitsPerWord + b;
+	  }
+	}
+      }
+      return MaxRecycled + overflow().fetch_add (1, std::memory_order_relaxed);
+    }
+
+    static void release (unsigned int index) {
+      slot() = 0;
+      if (index < (unsigned int) MaxRecycled) {
+	inUse()[index / BitsPerWord].fetch_and (~((uint64_t) 1 << (index % BitsPerWord)),
+						std::memory_order_release);
+      }
+    }
+
+#if defined(_WIN32)
+
+    struct ExitHook {
+      unsigned int index;
+      ~ExitHook() {
+	release (index);
+      }
+    };
+
+    static void registerExit (unsigned int index) {
+      static thread_local ExitHook hook;
+      hook.index = index;
+    }
+
+#else
+
+    // A thread-specific value's destructor runs at thread exit. (If a
+    // later destructor allocates, the thread takes a new index, which
+    // is released in the next round.)
+    static void registerExit (unsigned int index) {
+      static pthread_key_t key;
+      static pthread_once_t once = PTHREAD_ONCE_INIT;
+      pthread_once (&once, [] { pthread_key_create (&key, exitThread); });
+      pthread_setspecific (key, reinterpret_cast<void *>((uintptr_t) index + 1));
+    }
+
+    static void exitThread (void * value) {
+      release ((unsigned int) ((uintptr_t) value - 1));
+    }
+
+#endif
+
+  };
+
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "cpp23compat.h"  // C++20/23 compatibility - must be first
 #include "align.h"
+#include "atomicfreelist.h"
 #include "bins.h"
+#include "bulkcopy.h"
 
 //#include "bins16k.h"
 //#include "bins4k.h"
@@ -9,17 +11,26 @@
 //#include "bins8k.h"
 #include "binspow2.h"
 #include "checkpoweroftwo.h"
+#include "clearbudget.h"
 #include "dllist.h"
 #include "dynarray.h"
 #include "exactlyone.h"
 #include "freesllist.h"
 #include "hash.h"
+#include "heapstats.h"
 #include "ilog2.h"
 #include "gcd.h"
+#include "goodsize.h"
 #include "istrue.h"
 #include "lcm.h"
 #include "modulo.h"
+#include "samelayer.h"
 #include "sllist.h"
+#include "memalign.h"
 #include "timer.h"
+#include "trim.h"
+#include "tryresize.h"
+#include "tunables.h"
+#include "zeromemory.h"
 #include "tprintf.h"
 
@@ -0,0 +1,193 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_ATOMICFREELIST_H
+#define HL_ATOMICFREELIST_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16) && (defined(__x86_64__) || defined(__aarch64__))
+#define HL_HAVE_DWCAS 1
+#else
+#define HL_HAVE_DWCAS 0
+#endif
+
+/**
+ * @class AtomicFreeList
+ * @brief A lock-free stack of free objects (a Treiber stack).
+ *
+ * Like FreeSLList, the links are threaded through the objects, but
+ * any number of threads may push and pop at once. A pop reads the
+ * head's successor and then swings the head past it with a CAS; to
+ * keep that CAS from succeeding after the head was popped and pushed
+ * back in between (ABA), the head carries a version that every
+ * change increments.
+ *
+ * With a double-width CAS (x86-64 built with -mcx16, or AArch64), the
+ * head is a full pointer and a full-word version. Otherwise the two
+ * share one 64-bit word: on 64-bit targets, the pointer's low 48 bits
+ * (all that user-space addresses use on x86-64 and AArch64) and a
+ * 16-bit version, which only a thread stalled across 65536 other
+ * updates of this list could see wrap.
+ *
+ * pushChain and popAll move a whole linked chain in one CAS, for
+ * batch transfers between caches and a shared pool.
+ *
+ * A pop may read the link of an object that another thread has just
+ * popped (the CAS then fails), so objects on the list must stay
+ * mapped as long as the list is in use.
+ */
+
+namespace HL {
+
+  class AtomicFreeList {
+  public:
+
+    AtomicFreeList()
+      : _head ()
+    {}
+
+    /// The link threaded through a free object.
+    static inline void * getNext (void * ptr) {
+      return __atomic_load_n (reinterpret_cast<void **>(ptr), __ATOMIC_RELAXED);
+    }
+
+    static inline void setNext (void * ptr, void * next) {
+      __atomic_store_n (reinterpret_cast<void **>(ptr), next, __ATOMIC_RELAXED);
+    }
+
+    inline bool isEmpty() const {
+      return load().ptr == nullptr;
+    }
+
+    inline void push (void * ptr) {
+      pushChain (ptr, ptr);
+    }
+
+    /// Push a chain of objects, first to last, already linked by setNext.
+    inline void pushChain (void * first, void * last) {
+      Head old = load();
+      do {
+	setNext (last, old.ptr);
+      } while (!compareExchange (old, Head { first, old.tag + 1 }));
+    }
+
+    inline void * pop() {
+      Head old = load();
+      while (old.ptr != nullptr) {
+	if (compareExchange (old, Head { getNext (old.ptr), old.tag + 1 })) {
+	  return old.ptr;
+	}
+      }
+      return nullptr;
+    }
+
+    /// Take the whole list (a nullptr-terminated chain).
+    inline void * popAll() {
+      Head old = load();
+      while ((old.ptr != nullptr) && !compareExchange (old, Head { nullptr, old.tag + 1 })) {}
+      return old.ptr;
+    }
+
+  private:
+
+    struct Head {
+      void * ptr;
+      uintptr_t tag;
+    };
+
+#if HL_HAVE_DWCAS
+
+    typedef unsigned __int128 Word;
+
+    static inline Word pack (Head h) {
+      return ((Word) h.tag << 64) | (Word) (uintptr_t) h.ptr;
+    }
+
+    static inline Head unpack (Word w) {
+      return Head { reinterpret_cast<void *>((uintptr_t) w), (uintptr_t) (w >> 64) };
+    }
+
+    inline Head load() const {
+      // Two loads may tear, but then the CAS fails; either half is a
+      // valid pointer (or version) on its own.
+      const auto * halves = reinterpret_cast<const uintptr_t *>(&_head);
+      const auto tag = __atomic_load_n (&halves[1], __ATOMIC_ACQUIRE);
+      const auto ptr = __atomic_load_n (&halves[0], __ATOMIC_ACQUIRE);
+      return Head { reinterpret_cast<void *>(ptr), tag };
+    }
+
+    /// On failure, expected is updated to the current head.
+    inline bool compareExchange (Head& expected, Head desired) {
+      const Word e = pack (expected);
+      const Word seen = __sync_val_compare_and_swap (&_head, e, pack (desired));
+      if (seen == e) {
+	return true;
+      }
+      expected = unpack (seen);
+      return false;
+    }
+
+    alignas(16) Word _head;
+
+#else
+
+    typedef uint64_t Word;
+
+#if UINTPTR_MAX > 0xFFFFFFFFu
+    enum { PointerBits = 48 };
+#else
+    enum { PointerBits = 32 };
+#endif
+
+    static constexpr inline Word pointerMask() {
+      return ((Word) 1 << PointerBits) - 1;
+    }
+
+    static inline Word pack (Head h) {
+      return ((Word) h.tag << PointerBits) | ((Word) (uintptr_t) h.ptr & pointerMask());
+    }
+
+    static inline Head unpack (Word w) {
+      return Head { reinterpret_cast<void *>((uintptr_t) (w & pointerMask())), (uintptr_t) (w >> PointerBits) };
+    }
+
+    inline Head load() const {
+      return unpack (_head.load (std::memory_order_acquire));
+    }
+
+    /// On failure, expected is updated to the current head.
+    inline bool compareExchange (Head& expected, Head desired) {
+      Word e = pack (expected);
+      if (_head.compare_exchange_weak (e, pack (desired), std::memory_order_acq_rel, std::memory_order_acquire)) {
+	return true;
+      }
+      expected = unpack (e);
+      return false;
+    }
+
+    std::atomic<Word> _head;
+
+#endif
+
+  };
+
+}
+
+#endif
@@ -40,10 +40,10 @@ namespace HL {
       static_assert(BIG_OBJECT > 0, "BIG_OBJECT must be positive.");
       static_assert(getClassSize(0) < getClassSize(1), "Need distinct size classes.");
       static_assert(getSizeClass(getClassSize(0)) == 0, "Size class computation error.");
-      static_assert(getSizeClass(0) >= getSizeClass(alignof(max_align_t)), "Min size must be at least alignof(max_align_t).");
+      static_assert(getSizeClass(0) >= getSizeClass(MinClassSize), "Min size must be at least MinClassSize.");
 #ifndef NDEBUG
       int bins = 0;
-      for (auto i = alignof(max_align_t); i < BIG_OBJECT; i++) {
+      for (size_t i = MinClassSize; i < BIG_OBJECT; i++) {
 	bins++;
 	int sc = getSizeClass(i);
 	assert (getClassSize(sc) >= i);
@@ -70,20 +70,28 @@ namespace HL {
     
   public:
 
+    /// The smallest class: alignof(max_align_t), or 8 bytes with
+    /// HL_COMPACT_SMALL_OBJECTS.
+#if HL_COMPACT_SMALL_OBJECTS
+    enum : size_t { MinClassSize = 8 };
+#else
+    enum : size_t { MinClassSize = alignof(max_align_t) };
+#endif
+
     enum { BIG_OBJECT = Size / 8 }; // - sizeof(Header) };
-    enum { NUM_BINS   = ilog2_ceil(Size) - ilog2_ceil(alignof(max_align_t)) + 1 };
+    enum { NUM_BINS   = ilog2_ceil(Size) - ilog2_ceil(MinClassSize) + 1 };
     enum { NumBins = NUM_BINS };
     enum { MaxObjectSize = BIG_OBJECT };
-    enum { LogMaxAlignT = ilog2(alignof(max_align_t)) };
+    enum { LogMaxAlignT = ilog2(MinClassSize) };
     
     static inline constexpr int getSizeClass (size_t sz) {
-      sz = (sz < alignof(max_align_t)) ? alignof(max_align_t) : sz;
-      auto sizeClass = (int) HL::ilog2(sz) - LogMaxAlignT; // (int) HL::ilog2(alignof(max_align_t));
+      sz = (sz < MinClassSize) ? MinClassSize : sz;
+      auto sizeClass = (int) HL::ilog2(sz) - LogMaxAlignT; // (int) HL::ilog2(MinClassSize);
       return sizeClass;
     }
 
     static constexpr inline size_t getClassSize(int i) {
-      return (alignof(max_align_t) << i);
+      return (MinClassSize << i);
     }
     
     static constexpr inline size_t getClassMaxSize(int i) {
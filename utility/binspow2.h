@@ -38,10 +38,9 @@ namespace HL {
       static_assert(BIG_OBJECT > 0, "BIG_OBJECT must be positive.");
       static_assert(getClassSize(0) < getClassSize(1), "Need distinct size classes.");
       static_assert(getSizeClass(getClassSize(0)) == 0, "Size class computation error.");
-      static_assert(getSizeClass(0) >= getSizeClass(sizeof(max_align_t)), "Min size must be at least max_align_t.");
-      static_assert(getSizeClass(0) >= getSizeClass(alignof(max_align_t)), "Min size must be at least alignof(max_align_t).");
+      static_assert(getSizeClass(0) >= getSizeClass(MinClassSize), "Min size must be at least MinClassSize.");
 #ifndef NDEBUG
-      for (unsigned long i = sizeof(max_align_t); i < BIG_OBJECT; i++) {
+      for (unsigned long i = MinClassSize; i < BIG_OBJECT; i++) {
 	int sc = getSizeClass(i);
 	assert (getClassSize(sc) >= i);
 	assert (sc == 0 ? true : (getClassSize(sc-1) < i));
@@ -64,18 +63,26 @@ namespace HL {
     
   public:
 
+    /// The smallest class: sizeof(max_align_t), or 8 bytes with
+    /// HL_COMPACT_SMALL_OBJECTS.
+#if HL_COMPACT_SMALL_OBJECTS
+    enum : size_t { MinClassSize = 8 };
+#else
+    enum : size_t { MinClassSize = sizeof(max_align_t) };
+#endif
+
     enum { BIG_OBJECT = MaxSize };
     enum { MaxObjectSize = BIG_OBJECT };
-    enum { NUM_BINS   = HL::ilog2(MaxSize) - HL::ilog2(sizeof(max_align_t)) + 1 };
+    enum { NUM_BINS   = HL::ilog2(MaxSize) - HL::ilog2(MinClassSize) + 1 };
     enum { NumBins    = NUM_BINS };
 
     static inline constexpr int getSizeClass (size_t sz) {
-      sz = (sz < sizeof(max_align_t)) ? sizeof(max_align_t) : sz;
-      return static_cast<int>(HL::ilog2(sz) - HL::ilog2(sizeof(max_align_t)));
+      sz = (sz < MinClassSize) ? MinClassSize : sz;
+      return static_cast<int>(HL::ilog2(sz) - HL::ilog2(MinClassSize));
     }
 
     static constexpr inline size_t getClassSize (int i) {
-      return (sizeof(max_align_t) << i);
+      return (MinClassSize << i);
     }
 
     static constexpr inline size_t getClassMaxSize(int i) {
@@ -0,0 +1,229 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_BULKCOPY_H
+#define HL_BULKCOPY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string.h>
+
+#include "utility/cpp23compat.h"
+#include "utility/tunables.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define HL_BULKCOPY_X86 1
+#include <immintrin.h>
+#else
+#define HL_BULKCOPY_X86 0
+#endif
+
+/**
+ * @file bulkcopy.h
+ * @brief Copy and zero very large blocks without polluting the caches.
+ *
+ * realloc and calloc of many megabytes would otherwise stream the
+ * whole block through L2 and L3 with memcpy or memset, evicting the
+ * program's working set for data that will not be read again soon.
+ * Above a threshold (the bulk.nt_threshold tunable), HL::bulk_copy
+ * and HL::bulk_zero use non-temporal stores instead: AVX-512 or AVX2
+ * where the CPU has them (checked once, at run time), SSE2 otherwise.
+ * Smaller blocks, and other architectures, use memcpy and memset.
+ */
+
+namespace HL {
+
+  namespace detail {
+
+    /// Never bother looking up the threshold below this size.
+    enum { BulkMinBytes = 256 * 1024 };
+
+    typedef void (*BulkCopyFunction) (void *, const void *, size_t);
+    typedef void (*BulkZeroFunction) (void *, size_t);
+
+#if HL_BULKCOPY_X86
+
+    // Each kernel stores the (unaligned) head with memcpy/memset, so
+    // that the streaming stores are aligned, and the tail the same
+    // way after the fence.
+
+    __attribute__((target ("avx512f")))
+    inline void bulk_copy_avx512 (void * dst, const void * src, size_t n) {
+      auto * d = static_cast<char *>(dst);
+      auto * s = static_cast<const char *>(src);
+      const size_t head = (64 - (reinterpret_cast<uintptr_t>(d) & 63)) & 63;
+      memcpy (d, s, head);
+      d += head; s += head; n -= head;
+      for (; n >= 256; n -= 256, d += 256, s += 256) {
+	const __m512i a = _mm512_loadu_si512 (s);
+	const __m512i b = _mm512_loadu_si512 (s + 64);
+	const __m512i c = _mm512_loadu_si512 (s + 128);
+	const __m512i e = _mm512_loadu_si512 (s + 192);
+	_mm512_stream_si512 (reinterpret_cast<__m512i *>(d), a);
+	_mm512_stream_si512 (reinterpret_cast<__m512i *>(d + 64), b);
+	_mm512_stream_si512 (reinterpret_cast<__m512i *>(d + 128), c);
+	_mm512_stream_si512 (reinterpret_cast<__m512i *>(d + 192), e);
+      }
+      _mm_sfence();
+      memcpy (d, s, n);
+    }
+
+    __attribute__((target ("avx512f")))
+    inline void bulk_zero_avx512 (void * dst, size_t n) {
+      auto * d = static_cast<char *>(dst);
+      const size_t head = (64 - (reinterpret_cast<uintptr_t>(d) & 63)) & 63;
+      memset (d, 0, head);
+      d += head; n -= head;
+      const __m512i z = _mm512_setzero_si512();
+      for (; n >= 256; n -= 256, d += 256) {
+	_mm512_stream_si512 (reinterpret_cast<__m512i *>(d), z);
+	_mm512_stream_si512 (reinterpret_cast<__m512i *>(d + 64), z);
+	_mm512_stream_si512 (reinterpret_cast<__m512i *>(d + 128), z);
+	_mm512_stream_si512 (reinterpret_cast<__m512i *>(d + 192), z);
+      }
+      _mm_sfence();
+      memset (d, 0, n);
+    }
+
+    __attribute__((target ("avx2")))
+    inline void bulk_copy_avx2 (void * dst, const void * src, size_t n) {
+      auto * d = static_cast<char *>(dst);
+      auto * s = static_cast<const char *>(src);
+      const size_t head = (32 - (reinterpret_cast<uintptr_t>(d) & 31)) & 31;
+      memcpy (d, s, head);
+      d += head; s += head; n -= head;
+      for (; n >= 128; n -= 128, d += 128, s += 128) {
+	const __m256i a = _mm256_loadu_si256 (reinterpret_cast<const __m256i *>(s));
+	const __m256i b = _mm256_loadu_si256 (reinterpret_cast<const __m256i *>(s + 32));
+	const __m256i c = _mm256_loadu_si256 (reinterpret_cast<const __m256i *>(s + 64));
+	const __m256i e = _mm256_loadu_si256 (reinterpret_cast<const __m256i *>(s + 96));
+	_mm256_stream_si256 (reinterpret_cast<__m256i *>(d), a);
+	_mm256_stream_si256 (reinterpret_cast<__m256i *>(d + 32), b);
+	_mm256_stream_si256 (reinterpret_cast<__m256i *>(d + 64), c);
+	_mm256_stream_si256 (reinterpret_cast<__m256i *>(d + 96), e);
+      }
+      _mm_sfence();
+      memcpy (d, s, n);
+    }
+
+    __attribute__((target ("avx2")))
+    inline void bulk_zero_avx2 (void * dst, size_t n) {
+      auto * d = static_cast<char *>(dst);
+      const size_t head = (32 - (reinterpret_cast<uintptr_t>(d) & 31)) & 31;
+      memset (d, 0, head);
+      d += head; n -= head;
+      const __m256i z = _mm256_setzero_si256();
+      for (; n >= 128; n -= 128, d += 128) {
+	_mm256_stream_si256 (reinterpret_cast<__m256i *>(d), z);
+	_mm256_stream_si256 (reinterpret_cast<__m256i *>(d + 32), z);
+	_mm256_stream_si256 (reinterpret_cast<__m256i *>(d + 64), z);
+	_mm256_stream_si256 (reinterpret_cast<__m256i *>(d + 96), z);
+      }
+      _mm_sfence();
+      memset (d, 0, n);
+    }
+
+    // SSE2 is part of x86-64, so this needs no check.
+    inline void bulk_copy_sse2 (void * dst, const void * src, size_t n) {
+      auto * d = static_cast<char *>(dst);
+      auto * s = static_cast<const char *>(src);
+      const size_t head = (16 - (reinterpret_cast<uintptr_t>(d) & 15)) & 15;
+      memcpy (d, s, head);
+      d += head; s += head; n -= head;
+      for (; n >= 64; n -= 64, d += 64, s += 64) {
+	const __m128i a = _mm_loadu_si128 (reinterpret_cast<const __m128i *>(s));
+	const __m128i b = _mm_loadu_si128 (reinterpret_cast<const __m128i *>(s + 16));
+	const __m128i c = _mm_loadu_si128 (reinterpret_cast<const __m128i *>(s + 32));
+	const __m128i e = _mm_loadu_si128 (reinterpret_cast<const __m128i *>(s + 48));
+	_mm_stream_si128 (reinterpret_cast<__m128i *>(d), a);
+	_mm_stream_si128 (reinterpret_cast<__m128i *>(d + 16), b);
+	_mm_stream_si128 (reinterpret_cast<__m128i *>(d + 32), c);
+	_mm_stream_si128 (reinterpret_cast<__m128i *>(d + 48), e);
+      }
+      _mm_sfence();
+      memcpy (d, s, n);
+    }
+
+    inline void bulk_zero_sse2 (void * dst, size_t n) {
+      auto * d = static_cast<char *>(dst);
+      const size_t head = (16 - (reinterpret_cast<uintptr_t>(d) & 15)) & 15;
+      memset (d, 0, head);
+      d += head; n -= head;
+      const __m128i z = _mm_setzero_si128();
+      for (; n >= 64; n -= 64, d += 64) {
+	_mm_stream_si128 (reinterpret_cast<__m128i *>(d), z);
+	_mm_stream_si128 (reinterpret_cast<__m128i *>(d + 16), z);
+	_mm_stream_si128 (reinterpret_cast<__m128i *>(d + 32), z);
+	_mm_stream_si128 (reinterpret_cast<__m128i *>(d + 48), z);
+      }
+      _mm_sfence();
+      memset (d, 0, n);
+    }
+
+    /// The best kernels this CPU supports.
+    struct BulkKernels {
+      BulkCopyFunction copy;
+      BulkZeroFunction zero;
+    };
+
+    inline const BulkKernels& bulkKernels() {
+      static const BulkKernels kernels = [] {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports ("avx512f")) {
+	  return BulkKernels { bulk_copy_avx512, bulk_zero_avx512 };
+	}
+	if (__builtin_cpu_supports ("avx2")) {
+	  return BulkKernels { bulk_copy_avx2, bulk_zero_avx2 };
+	}
+	return BulkKernels { bulk_copy_sse2, bulk_zero_sse2 };
+      }();
+      return kernels;
+    }
+
+    inline bool useBulk (size_t n) {
+      return (n >= (size_t) BulkMinBytes) && (n >= Tunables::get (Tunables::BulkThreshold));
+    }
+
+#endif
+
+  }
+
+  /// Copy n bytes (non-overlapping), bypassing the caches for large n.
+  inline void bulk_copy (void * dst, const void * src, size_t n) {
+#if HL_BULKCOPY_X86
+    if (HL_EXPECT_FALSE(detail::useBulk (n))) HL_UNLIKELY {
+      detail::bulkKernels().copy (dst, src, n);
+      return;
+    }
+#endif
+    memcpy (dst, src, n);
+  }
+
+  /// Zero n bytes, bypassing the caches for large n.
+  inline void bulk_zero (void * dst, size_t n) {
+#if HL_BULKCOPY_X86
+    if (HL_EXPECT_FALSE(detail::useBulk (n))) HL_UNLIKELY {
+      detail::bulkKernels().zero (dst, n);
+      return;
+    }
+#endif
+    memset (dst, 0, n);
+  }
+
+}
+
+#endif
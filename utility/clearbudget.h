@@ -0,0 +1,188 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_CLEARBUDGET_H
+#define HL_CLEARBUDGET_H
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+/**
+ * @file clearbudget.h
+ * @brief Support for incremental (bounded-time) heap teardown.
+ *
+ * Layers that can release their memory a piece at a time provide
+ * <TT>bool clear_step (ClearBudget&)</TT>, which does at most the
+ * work allowed by the budget and returns true once the heap is
+ * completely clear. Layers whose free() is a no-op (zones, bump
+ * allocators) declare <TT>enum { FreeIsNoop = 1 }</TT>, which lets
+ * the layers above them drop their cached objects in O(1) instead of
+ * handing them back one at a time.
+ */
+
+namespace HL {
+
+  /**
+   * @class ClearBudget
+   * @brief Bounds the work done by one call to clear_step().
+   *
+   * A budget limits the number of objects, bytes and/or nanoseconds
+   * one clear_step() may spend. Drive it from an idle hook:
+   *
+   * <TT>
+   *   auto budget = HL::ClearBudget::nanoseconds (50000);<BR>
+   *   if (!heap.clear_step (budget)) { reschedule(); }<BR>
+   * </TT>
+   */
+
+  class ClearBudget {
+  public:
+
+    ClearBudget (size_t maxObjects, size_t maxBytes, long long maxNanoseconds)
+      : _objectsLeft (maxObjects),
+	_bytesLeft (maxBytes),
+	_timed (maxNanoseconds >= 0),
+	_deadline (std::chrono::steady_clock::now() + std::chrono::nanoseconds (_timed ? maxNanoseconds : 0)),
+	_untilClockCheck (ClockCheckInterval),
+	_exhausted (false)
+    {}
+
+    static ClearBudget objects (size_t n) {
+      return ClearBudget (n, Unlimited, -1);
+    }
+
+    static ClearBudget bytes (size_t n) {
+      return ClearBudget (Unlimited, n, -1);
+    }
+
+    static ClearBudget nanoseconds (long long ns) {
+      return ClearBudget (Unlimited, Unlimited, ns);
+    }
+
+    static ClearBudget unlimited() {
+      return ClearBudget (Unlimited, Unlimited, -1);
+    }
+
+    /// Account for one released object (or span) of the given size
+    /// (0 if unknown). Returns true if there is budget left.
+    inline bool charge (size_t sz) {
+      if (_objectsLeft != Unlimited) {
+	_objectsLeft = (_objectsLeft > 1) ? _objectsLeft - 1 : 0;
+      }
+      if (_bytesLeft != Unlimited) {
+	_bytesLeft = (_bytesLeft > sz) ? _bytesLeft - sz : 0;
+      }
+      if ((_objectsLeft == 0) || (_bytesLeft == 0)) {
+	_exhausted = true;
+      }
+      // Reading the clock is comparatively expensive, so only do it
+      // every so often.
+      if (_timed && (--_untilClockCheck == 0)) {
+	_untilClockCheck = ClockCheckInterval;
+	if (std::chrono::steady_clock::now() >= _deadline) {
+	  _exhausted = true;
+	}
+      }
+      return !_exhausted;
+    }
+
+    inline bool exhausted() const {
+      return _exhausted;
+    }
+
+    /// True if there is budget left, reading the clock now rather than
+    /// every so often: for steps that are costly one at a time (such
+    /// as releasing a whole arena), to ask before each one.
+    inline bool allows() {
+      if (_timed && !_exhausted && (std::chrono::steady_clock::now() >= _deadline)) {
+	_exhausted = true;
+      }
+      return !_exhausted;
+    }
+
+  private:
+
+    enum : size_t { Unlimited = std::numeric_limits<size_t>::max() };
+    enum { ClockCheckInterval = 32 };
+
+    size_t _objectsLeft;
+    size_t _bytesLeft;
+    bool _timed;
+    std::chrono::steady_clock::time_point _deadline;
+    int _untilClockCheck;
+    bool _exhausted;
+  };
+
+  /// True if Heap declares that its free() does nothing (its memory is
+  /// only reclaimed wholesale, by clear() or destruction).
+  template <class Heap, class = void>
+  struct free_is_noop : std::false_type {};
+
+  template <class Heap>
+  struct free_is_noop<Heap, decltype((void) Heap::FreeIsNoop)>
+    : std::integral_constant<bool, (Heap::FreeIsNoop != 0)> {};
+
+  namespace detail {
+
+    template <class Heap>
+    inline auto charge_size (Heap& heap, void * ptr, size_t, int)
+      -> decltype((size_t) heap.getSize (ptr))
+    {
+      return heap.getSize (ptr);
+    }
+
+    template <class Heap>
+    inline size_t charge_size (Heap&, void *, size_t fallback, long)
+    {
+      return fallback;
+    }
+
+    template <class Heap>
+    inline auto clear_step (Heap& heap, ClearBudget& budget, int)
+      -> decltype(heap.clear_step (budget))
+    {
+      return heap.clear_step (budget);
+    }
+
+    template <class Heap>
+    inline bool clear_step (Heap& heap, ClearBudget&, long)
+    {
+      // No incremental support: clear in one go.
+      heap.clear();
+      return true;
+    }
+
+  }
+
+  /// The size to charge for releasing ptr: heap.getSize(ptr) if the
+  /// heap has it, or fallback otherwise.
+  template <class Heap>
+  inline size_t charge_size (Heap& heap, void * ptr, size_t fallback) {
+    return detail::charge_size (heap, ptr, fallback, 0);
+  }
+
+  /// Call heap.clear_step(budget) if the heap has it, or heap.clear() otherwise.
+  template <class Heap>
+  inline bool clear_step (Heap& heap, ClearBudget& budget) {
+    return detail::clear_step (heap, budget, 0);
+  }
+
+}
+
+#endif
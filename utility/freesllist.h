@@ -22,6 +22,10 @@ public:
     head.next = nullptr;
   }
 
+  inline bool isEmpty() const {
+    return (head.next == nullptr);
+  }
+
   class Entry;
   
   /// Get the head of the list.
@@ -0,0 +1,62 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_GOODSIZE_H
+#define HL_GOODSIZE_H
+
+#include <cstddef>
+
+/**
+ * @file goodsize.h
+ * @brief Support for size-class rounding (the optional good_size protocol).
+ *
+ * A layer that rounds requests up (to a size class, a page, ...)
+ * provides <TT>size_t good_size (size_t sz)</TT>, returning the size
+ * a request for sz bytes would actually get. Asking for that size
+ * instead costs nothing extra, which lets growable containers use
+ * the slack. Layers that round nothing need not define it.
+ */
+
+namespace HL {
+
+  namespace detail {
+
+    template <class Heap>
+    inline auto good_size (Heap& heap, size_t sz, int)
+      -> decltype(heap.good_size (sz))
+    {
+      return heap.good_size (sz);
+    }
+
+    template <class Heap>
+    inline size_t good_size (Heap&, size_t sz, long)
+    {
+      // No rounding.
+      return sz;
+    }
+
+  }
+
+  /// The size heap would really allocate for a request of sz bytes.
+  template <class Heap>
+  inline size_t good_size (Heap& heap, size_t sz) {
+    return detail::good_size (heap, sz, 0);
+  }
+
+}
+
+#endif
@@ -0,0 +1,154 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_HEAPSTATS_H
+#define HL_HEAPSTATS_H
+
+#include <cstddef>
+
+/**
+ * @file heapstats.h
+ * @brief Support for heap statistics (the optional collect_stats protocol).
+ *
+ * Nothing is counted on the malloc/free paths. Instead, a layer that
+ * holds memory provides <TT>void collect_stats (HeapStats&)</TT>,
+ * which adds what it holds right now (walking its own structures if
+ * necessary) and then asks the layers it allocates from to do the
+ * same. Layers that carve arenas out of their superheap account for
+ * that memory themselves and do not recurse.
+ */
+
+namespace HL {
+
+  /**
+   * @class HeapStats
+   * @brief A snapshot of what a heap holds, filled in by collect_stats.
+   *
+   * A plain struct, so that it can be passed across the xx* interface.
+   */
+
+  struct HeapStats {
+
+    enum { MaxClasses = 128 };
+    enum { MaxShared = 16 };
+
+    /// Bytes in arenas (or chunks) obtained from a source heap.
+    size_t arenaBytes;
+
+    /// Arena bytes not yet handed out.
+    size_t unusedBytes;
+
+    /// Bytes in objects allocated straight from a source heap.
+    size_t directBytes;
+
+    /// Bytes held in page mappings.
+    size_t mmapBytes;
+
+    /// Free objects cached in size-class bins (all classes).
+    size_t freeBytes;
+    size_t freeObjects;
+
+    /// Free bytes cached in thread-local caches.
+    size_t threadCacheBytes;
+
+    /// Per-class free lists: largest object size, bytes and objects.
+    int numClasses;
+    size_t classSize[MaxClasses];
+    size_t classFreeBytes[MaxClasses];
+    size_t classFreeObjects[MaxClasses];
+
+    /// Shared heaps already reported, so that one reached from several
+    /// heaps (through a UniqueHeap) is counted once.
+    int numShared;
+    const void * shared[MaxShared];
+
+    void clear() {
+      arenaBytes = unusedBytes = directBytes = mmapBytes = 0;
+      freeBytes = freeObjects = threadCacheBytes = 0;
+      numClasses = 0;
+      numShared = 0;
+      for (int i = 0; i < MaxClasses; i++) {
+	classSize[i] = classFreeBytes[i] = classFreeObjects[i] = 0;
+      }
+    }
+
+    /// Record cached free objects of size class i.
+    void addFree (int i, size_t sz, size_t objects, size_t bytes) {
+      freeObjects += objects;
+      freeBytes += bytes;
+      if ((i < 0) || (i >= MaxClasses)) {
+	return;
+      }
+      classSize[i] = sz;
+      classFreeObjects[i] += objects;
+      classFreeBytes[i] += bytes;
+      if (numClasses <= i) {
+	numClasses = i + 1;
+      }
+    }
+
+    /// True the first time a shared heap is seen (so report it then).
+    bool firstVisit (const void * heap) {
+      for (int i = 0; i < numShared; i++) {
+	if (shared[i] == heap) {
+	  return false;
+	}
+      }
+      if (numShared < MaxShared) {
+	shared[numShared++] = heap;
+      }
+      return true;
+    }
+
+    /// All memory obtained from source heaps.
+    size_t totalBytes() const {
+      return arenaBytes + directBytes;
+    }
+
+    /// Memory in live objects (including their headers and rounding).
+    size_t inUseBytes() const {
+      const size_t idle = unusedBytes + freeBytes + threadCacheBytes;
+      return (totalBytes() > idle) ? totalBytes() - idle : 0;
+    }
+  };
+
+  namespace detail {
+
+    template <class Heap>
+    inline auto collect_stats (Heap& heap, HeapStats& stats, int)
+      -> decltype(heap.collect_stats (stats))
+    {
+      return heap.collect_stats (stats);
+    }
+
+    template <class Heap>
+    inline void collect_stats (Heap&, HeapStats&, long)
+    {
+      // Nothing to report.
+    }
+
+  }
+
+  /// Add heap's contribution to stats, if it has any.
+  template <class Heap>
+  inline void collect_stats (Heap& heap, HeapStats& stats) {
+    detail::collect_stats (heap, stats, 0);
+  }
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_MEMALIGN_H
+#define HL_MEMALIGN_H
+
+#include <cstddef>
+#include <type_traits>
+
+#include "utility/samelayer.h"
+
+/**
+ * @file memalign.h
+ * @brief Support for aligned allocation (the optional memalign protocol).
+ *
+ * A layer that can hand out objects on a stricter boundary than its
+ * Alignment provides <TT>void * memalign (size_t alignment, size_t sz)</TT>.
+ * The result must be an ordinary object of the layer: getSize, free
+ * and try_resize all work on it unchanged. That rules out aligning
+ * inside an over-sized block (as generic_xxmemalign does), unless the
+ * layer's free() does nothing or the layer records where the block
+ * really starts (as SizeHeap does).
+ *
+ * As with the other optional methods, a layer's memalign is only used
+ * if the same layer provides its malloc (see samelayer.h): a layer
+ * that adds a header must place it itself. Alignments must be powers
+ * of two. Calling HL::memalign() on a heap without a memalign of its
+ * own does not compile, since it could only satisfy requests up to
+ * the heap's Alignment.
+ */
+
+namespace HL {
+
+  /// True if alignment is a (non-zero) power of two.
+  inline constexpr bool is_power_of_two (size_t alignment) {
+    return (alignment != 0) && ((alignment & (alignment - 1)) == 0);
+  }
+
+  /// True if Heap's own layer (the one providing its malloc) provides memalign.
+  template <class Heap, class = void>
+  struct has_memalign : std::false_type {};
+
+  template <class Heap>
+  struct has_memalign<Heap, decltype((void) &Heap::memalign, (void) &Heap::malloc)>
+    : same_layer<decltype(&Heap::memalign), decltype(&Heap::malloc)> {};
+
+  /// Allocate sz bytes aligned to alignment (a power of two) from
+  /// heap, which must provide memalign.
+  template <class Heap>
+  inline void * memalign (Heap& heap, size_t alignment, size_t sz) {
+    static_assert (has_memalign<Heap>::value,
+		   "The heap (the layer providing its malloc) has no memalign.");
+    return heap.memalign (alignment, sz);
+  }
+
+}
+
+#endif
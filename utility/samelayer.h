@@ -0,0 +1,65 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_SAMELAYER_H
+#define HL_SAMELAYER_H
+
+#include <type_traits>
+
+/**
+ * @file samelayer.h
+ * @brief Tells whether two methods of a heap come from the same layer.
+ *
+ * Optional methods (malloc_zeroed, memalign, try_resize) are inherited
+ * like any other, so a layer that wraps malloc without overriding
+ * them would be skipped: DebugHeap<SizeHeap<...>> would get
+ * SizeHeap's try_resize, and its canary would never move. The
+ * protocols therefore only use an optional method when the layer that
+ * provides Heap's malloc also declares it (compare the class of
+ * <TT>&Heap::malloc_zeroed</TT> with that of <TT>&Heap::malloc</TT>).
+ *
+ * Static member functions carry no class, so two static methods
+ * always match; a layer with a static malloc must declare its other
+ * static methods itself (as SizedMmapHeap does).
+ */
+
+namespace HL {
+
+  namespace detail {
+
+    /// The class a member function was declared in (void for a static one).
+    template <class Method>
+    struct declaring_class {
+      typedef void type;
+    };
+
+    template <class Result, class Class>
+    struct declaring_class<Result Class::*> {
+      typedef Class type;
+    };
+
+  }
+
+  /// True if the methods whose addresses have types F and G were declared in the same class.
+  template <class F, class G>
+  struct same_layer
+    : std::is_same<typename detail::declaring_class<F>::type,
+		   typename detail::declaring_class<G>::type> {};
+
+}
+
+#endif
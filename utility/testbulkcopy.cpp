@@ -0,0 +1,111 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+/*
+ * Shows what a large copy or zeroing does to the rest of the cache:
+ * a small "working set" is walked, a big block is copied (or zeroed)
+ * with memcpy/memset or with HL::bulk_copy/bulk_zero, and the working
+ * set is walked again. With plain stores the second walk misses;
+ * with non-temporal stores it stays warm.
+ *
+ *   g++ -std=c++14 -O2 -I.. testbulkcopy.cpp -o testbulkcopy
+ *   ./testbulkcopy [block MB] [working set KB]
+ *
+ * Note that glibc's memcpy switches to non-temporal stores itself
+ * once a copy approaches the size of the LLC, so the difference shows
+ * for blocks between the bulk.nt_threshold tunable and that size.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "bulkcopy.h"
+#include "timer.h"
+
+using namespace std;
+
+static size_t WorkingSet = 1 << 20;	// Should fit in L2 or L3.
+static size_t BlockSize = 16 << 20;
+static const int Rounds = 20;
+
+static volatile unsigned long sink;
+
+static double walk (const unsigned long * ws) {
+  HL::Timer t;
+  t.start();
+  unsigned long sum = 0;
+  for (int pass = 0; pass < 4; pass++) {
+    for (size_t i = 0; i < WorkingSet / sizeof(unsigned long); i += 8) {
+      sum += ws[i];
+    }
+  }
+  t.stop();
+  sink = sum;
+  return (double) t;
+}
+
+template <class Op>
+static void run (const char * name, const unsigned long * ws, Op op) {
+  double opTime = 0, warm = 0, after = 0;
+  for (int r = 0; r < Rounds; r++) {
+    warm += walk (ws);
+    HL::Timer t;
+    t.start();
+    op();
+    t.stop();
+    opTime += (double) t;
+    after += walk (ws);
+  }
+  printf ("%-12s op %8.3f ms   working set warm %7.1f us, after op %7.1f us\n",
+	  name, 1000 * opTime / Rounds, 1e6 * warm / Rounds, 1e6 * after / Rounds);
+}
+
+int main (int argc, char * argv[]) {
+  if (argc > 1) {
+    BlockSize = (size_t) atoi (argv[1]) << 20;
+  }
+  if (argc > 2) {
+    WorkingSet = (size_t) atoi (argv[2]) << 10;
+  }
+  auto * ws = (unsigned long *) calloc (WorkingSet, 1);
+  auto * src = (char *) malloc (BlockSize);
+  auto * dst = (char *) malloc (BlockSize);
+  memset (src, 1, BlockSize);
+  memset (dst, 2, BlockSize);
+
+  run ("memcpy", ws, [&] { memcpy (dst, src, BlockSize); });
+  run ("bulk_copy", ws, [&] { HL::bulk_copy (dst, src, BlockSize); });
+  run ("memset", ws, [&] { memset (dst, 0, BlockSize); });
+  run ("bulk_zero", ws, [&] { HL::bulk_zero (dst, BlockSize); });
+
+  // Check the results.
+  HL::bulk_copy (dst + 3, src + 5, BlockSize - 8);
+  if (memcmp (dst + 3, src + 5, BlockSize - 8) != 0) {
+    cout << "bulk_copy mismatch" << endl;
+    return 1;
+  }
+  HL::bulk_zero (dst + 1, BlockSize - 2);
+  for (size_t i = 1; i < BlockSize - 1; i++) {
+    if (dst[i] != 0) {
+      cout << "bulk_zero mismatch" << endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,100 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_TRIM_H
+#define HL_TRIM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "threads/cpuinfo.h"
+
+/**
+ * @file trim.h
+ * @brief Support for giving cached memory back (the optional trim protocol).
+ *
+ * A layer that caches free memory provides <TT>size_t trim (size_t pad)</TT>.
+ * It hands its cached objects back to the layer below (or, when
+ * that would not release anything, discards the whole pages inside
+ * them), then trims the layer below. It returns the number of bytes
+ * released to the system (pages unmapped or discarded); objects just
+ * handed to the layer below do not count. As with malloc_trim, pad
+ * is the amount of spare space to leave untouched at the end of the
+ * source heap (the current zone arena or bump chunk).
+ */
+
+namespace HL {
+
+  /// Room at the start of a free object that must survive trimming
+  /// (enough for the links of any of our freelists).
+  enum { TrimKeepBytes = 2 * sizeof(void *) };
+
+  /// Discard the whole pages in [ptr + keep, ptr + sz) of page-backed
+  /// memory, which will read back as zero. Returns the bytes discarded.
+  inline size_t release_pages (void * ptr, size_t sz, size_t keep = TrimKeepBytes) {
+#if defined(__linux__)
+    if (sz <= keep + CPUInfo::PageSize) {
+      return 0;
+    }
+    const auto start = reinterpret_cast<uintptr_t>(ptr) + keep;
+    const auto end = reinterpret_cast<uintptr_t>(ptr) + sz;
+    const auto pageStart = (start + CPUInfo::PageSize - 1) & ~(uintptr_t) (CPUInfo::PageSize - 1);
+    const auto pageEnd = end & ~(uintptr_t) (CPUInfo::PageSize - 1);
+    if ((pageEnd <= pageStart) ||
+	(madvise (reinterpret_cast<void *>(pageStart), pageEnd - pageStart, MADV_DONTNEED) != 0)) {
+      return 0;
+    }
+    return pageEnd - pageStart;
+#else
+    (void) ptr;
+    (void) sz;
+    (void) keep;
+    return 0;
+#endif
+  }
+
+  namespace detail {
+
+    template <class Heap>
+    inline auto trim (Heap& heap, size_t pad, int)
+      -> decltype(heap.trim (pad))
+    {
+      return heap.trim (pad);
+    }
+
+    template <class Heap>
+    inline size_t trim (Heap&, size_t, long)
+    {
+      // Nothing cached.
+      return 0;
+    }
+
+  }
+
+  /// Call heap.trim(pad) if the heap has it; 0 otherwise.
+  template <class Heap>
+  inline size_t trim (Heap& heap, size_t pad) {
+    return detail::trim (heap, pad, 0);
+  }
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_TRYRESIZE_H
+#define HL_TRYRESIZE_H
+
+#include <cstddef>
+#include <type_traits>
+
+#include "utility/samelayer.h"
+
+/**
+ * @file tryresize.h
+ * @brief Support for in-place resizing (the optional try_resize protocol).
+ *
+ * A layer that can sometimes grow or shrink an object without moving
+ * it provides <TT>bool try_resize (void * ptr, size_t newSize)</TT>.
+ * It returns true if the object at ptr can now hold newSize bytes
+ * (and will be freed correctly), and false, leaving the object
+ * untouched, otherwise. Callers should then fall back to
+ * malloc/copy/free.
+ *
+ * The method is only used if it comes from the same layer as the
+ * heap's malloc (see samelayer.h): a layer that wraps malloc (adding
+ * a header or canary, say) and does not provide try_resize itself
+ * cannot resize in place.
+ */
+
+namespace HL {
+
+  /// True if Heap's own layer (the one providing its malloc) provides try_resize.
+  template <class Heap, class = void>
+  struct has_try_resize : std::false_type {};
+
+  template <class Heap>
+  struct has_try_resize<Heap, decltype((void) &Heap::try_resize, (void) &Heap::malloc)>
+    : same_layer<decltype(&Heap::try_resize), decltype(&Heap::malloc)> {};
+
+  namespace detail {
+
+    template <class Heap>
+    inline bool try_resize (Heap& heap, void * ptr, size_t newSize, std::true_type)
+    {
+      return heap.try_resize (ptr, newSize);
+    }
+
+    template <class Heap>
+    inline bool try_resize (Heap&, void *, size_t, std::false_type)
+    {
+      // No in-place support.
+      return false;
+    }
+
+  }
+
+  /// Call heap.try_resize(ptr, newSize) if the heap has it; false otherwise.
+  template <class Heap>
+  inline bool try_resize (Heap& heap, void * ptr, size_t newSize) {
+    return detail::try_resize (heap, ptr, newSize, has_try_resize<Heap>());
+  }
+
+}
+
+#endif
@@ -0,0 +1,266 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_TUNABLES_H
+#define HL_TUNABLES_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * @file tunables.h
+ * @brief A registry of runtime-adjustable heap parameters.
+ *
+ * Each knob has a compile-time default (0 means "whatever the layer's
+ * template parameter says") and a legal range. The values are read
+ * once, on first use, from the HL_CONF environment variable, a comma-
+ * or colon-separated list of name=value pairs; byte sizes accept a
+ * k, m or g suffix:
+ *
+ * <TT>
+ *   HL_CONF=zone.chunk_size=1m,spinlock.spin_count=200
+ * </TT>
+ *
+ * They can be changed later with Tunables::ctl(), exported by the
+ * wrappers as <TT>hl_ctl(name, oldp, newp)</TT>. Every change bumps
+ * an epoch counter, so layers can keep a plain copy of a value and
+ * re-read it only when the epoch moves (or only on their slow paths),
+ * keeping atomics off malloc and free.
+ */
+
+namespace HL {
+
+  class Tunables {
+  public:
+
+    enum Id {
+      ZoneChunkSize,	///< ZoneHeap arena size (0 = ChunkSize).
+      BumpChunkSize,	///< BumpAlloc chunk size (0 = ChunkSize).
+      FreelistBound,	///< BoundedFreeListHeap capacity (0 = numObjects).
+      SpinCount,	///< Spins before SpinLockType yields.
+      FutexMaxSpin,	///< Most spins before FutexLockType sleeps.
+      ThreadHeaps,	///< ThreadHeap heaps in use (0 = NumHeaps).
+      BulkThreshold,	///< Copies and zeroings this large bypass the caches.
+      NumTunables
+    };
+
+    enum Kind { Bytes, Count };
+
+    struct Entry {
+      const char * name;
+      Kind kind;
+      size_t defaultValue;
+      size_t minValue;
+      size_t maxValue;
+    };
+
+    /// The current value of a tunable.
+    static inline size_t get (Id id) {
+      init();
+      return values()[id].load (std::memory_order_relaxed);
+    }
+
+    /// Incremented on every change; compare against a cached copy to
+    /// see whether cached values are stale.
+    static inline unsigned long epoch() {
+      return epochCounter().load (std::memory_order_acquire);
+    }
+
+    /**
+     * Read and/or write a tunable by name. If oldp is non-null, the
+     * previous value is stored there; if newp is non-null, the value
+     * is replaced. Returns 0, ENOENT (unknown name) or EINVAL (new
+     * value out of range).
+     */
+    static int ctl (const char * name, size_t * oldp, const size_t * newp) {
+      init();
+      const int id = find (name, strlen (name));
+      if (id < 0) {
+	return ENOENT;
+      }
+      if (newp && !inRange (id, *newp)) {
+	return EINVAL;
+      }
+      if (oldp) {
+	*oldp = values()[id].load (std::memory_order_relaxed);
+      }
+      if (newp) {
+	values()[id].store (*newp, std::memory_order_relaxed);
+	epochCounter().fetch_add (1, std::memory_order_release);
+      }
+      return 0;
+    }
+
+    /// Apply a configuration string (as in HL_CONF). Unknown names and
+    /// malformed or out-of-range values are skipped.
+    static void configure (const char * conf) {
+      init();
+      apply (conf);
+    }
+
+    static const Entry& entry (Id id) {
+      return entries()[id];
+    }
+
+  private:
+
+    static const Entry * entries() {
+      static const Entry theEntries[NumTunables] = {
+	{ "zone.chunk_size",     Bytes, 0,    0, (size_t) 1 << 40 },
+	{ "bump.chunk_size",     Bytes, 0,    0, (size_t) 1 << 40 },
+	{ "freelist.bound",      Count, 0,    0, (size_t) 1 << 30 },
+	{ "spinlock.spin_count", Count, 1000, 1, (size_t) 1 << 30 },
+	{ "futexlock.max_spin",  Count, 100,  0, (size_t) 1 << 20 },
+	{ "threadheap.heaps",    Count, 0,    0, (size_t) 1 << 20 },
+	{ "bulk.nt_threshold",   Bytes, (size_t) 4 << 20, 0, ~(size_t) 0 },
+      };
+      return theEntries;
+    }
+
+    static std::atomic<size_t> * values() {
+      static std::atomic<size_t> theValues[NumTunables];
+      return theValues;
+    }
+
+    static std::atomic<unsigned long>& epochCounter() {
+      static std::atomic<unsigned long> theEpoch (0);
+      return theEpoch;
+    }
+
+    /// Load the defaults, then HL_CONF, the first time through (other
+    /// threads wait for that to finish). None of this allocates, so it
+    /// is safe to reach from inside malloc.
+    static inline void init() {
+      enum { Uninitialized, Initializing, Initialized };
+      static std::atomic<int> state (Uninitialized);
+      if (state.load (std::memory_order_acquire) == Initialized) {
+	return;
+      }
+      int expected = Uninitialized;
+      if (!state.compare_exchange_strong (expected, Initializing, std::memory_order_acquire)) {
+	while (state.load (std::memory_order_acquire) != Initialized) {}
+	return;
+      }
+      for (int i = 0; i < NumTunables; i++) {
+	values()[i].store (entries()[i].defaultValue, std::memory_order_relaxed);
+      }
+#if !defined(_WIN32)
+      apply (::getenv ("HL_CONF"));
+#endif
+      state.store (Initialized, std::memory_order_release);
+    }
+
+    static void apply (const char * conf) {
+      if (conf == nullptr) {
+	return;
+      }
+      while (*conf) {
+	const char * end = conf;
+	while (*end && (*end != ',') && (*end != ':')) {
+	  end++;
+	}
+	const char * eq = conf;
+	while ((eq < end) && (*eq != '=')) {
+	  eq++;
+	}
+	if (eq < end) {
+	  const int id = find (conf, (size_t) (eq - conf));
+	  size_t value;
+	  if ((id >= 0) && parse (eq + 1, end, entries()[id].kind, value) && inRange (id, value)) {
+	    values()[id].store (value, std::memory_order_relaxed);
+	  }
+	}
+	conf = *end ? end + 1 : end;
+      }
+      epochCounter().fetch_add (1, std::memory_order_release);
+    }
+
+    static int find (const char * name, size_t len) {
+      for (int i = 0; i < NumTunables; i++) {
+	if ((strlen (entries()[i].name) == len) && (strncmp (entries()[i].name, name, len) == 0)) {
+	  return i;
+	}
+      }
+      return -1;
+    }
+
+    static bool inRange (int id, size_t value) {
+      return (value == 0 && entries()[id].defaultValue == 0)
+	|| ((value >= entries()[id].minValue) && (value <= entries()[id].maxValue));
+    }
+
+    static bool parse (const char * s, const char * end, Kind kind, size_t& value) {
+      if (s == end) {
+	return false;
+      }
+      value = 0;
+      for (; (s < end) && (*s >= '0') && (*s <= '9'); s++) {
+	value = value * 10 + (size_t) (*s - '0');
+      }
+      if ((s < end) && (kind == Bytes)) {
+	switch (*s++) {
+	case 'k': case 'K': value <<= 10; break;
+	case 'm': case 'M': value <<= 20; break;
+	case 'g': case 'G': value <<= 30; break;
+	default: return false;
+	}
+      }
+      return (s == end);
+    }
+
+  };
+
+  /**
+   * @class TunableCache
+   * @brief A plain copy of one tunable, refreshed only when the epoch moves.
+   */
+
+  template <Tunables::Id id>
+  class TunableCache {
+  public:
+
+    constexpr TunableCache()
+      : _epoch (~0UL),
+	_value (0)
+    {}
+
+    /// The tunable's value, or fallback if it is 0 ("use the default").
+    inline size_t get (size_t fallback) {
+      refresh();
+      return _value ? _value : fallback;
+    }
+
+    /// Re-read the value if it has changed since we last looked.
+    inline void refresh() {
+      const auto e = Tunables::epoch();
+      if (e != _epoch) {
+	_value = Tunables::get (id);
+	_epoch = e;
+      }
+    }
+
+  private:
+    unsigned long _epoch;
+    size_t _value;
+  };
+
+}
+
+#endif
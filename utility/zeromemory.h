@@ -0,0 +1,132 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_ZEROMEMORY_H
+#define HL_ZEROMEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string.h>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include "threads/cpuinfo.h"
+#endif
+
+#include "utility/bulkcopy.h"
+#include "utility/samelayer.h"
+
+/**
+ * @file zeromemory.h
+ * @brief Support for known-zero memory (the optional malloc_zeroed protocol).
+ *
+ * Source heaps whose memory always arrives zero-filled (fresh
+ * anonymous mappings) declare <TT>enum { ZeroMemory = 1 }</TT>;
+ * layers that recycle objects reset it to 0. Heaps whose memory comes
+ * from private anonymous pages also declare <TT>enum { PageBacked = 1 }</TT>,
+ * which recycling does not change.
+ *
+ * Layers that can hand out zero-filled memory more cheaply than
+ * malloc followed by memset provide <TT>void * malloc_zeroed (size_t)</TT>;
+ * calloc is built on HL::malloc_zeroed(), which falls back to exactly
+ * that. As with the other optional methods, a layer's malloc_zeroed is
+ * only used if the same layer provides its malloc (see samelayer.h),
+ * so layers that wrap malloc (DebugHeap, AddHeap, ...) are never
+ * bypassed.
+ */
+
+namespace HL {
+
+  /// True if every object Heap::malloc returns is known to be zero-filled.
+  template <class Heap, class = void>
+  struct zero_memory : std::false_type {};
+
+  template <class Heap>
+  struct zero_memory<Heap, decltype((void) Heap::ZeroMemory)>
+    : std::integral_constant<bool, (Heap::ZeroMemory != 0)> {};
+
+  /// True if Heap's memory comes from private anonymous pages (so
+  /// discarding whole pages reads back as zeroes).
+  template <class Heap, class = void>
+  struct page_backed : std::false_type {};
+
+  template <class Heap>
+  struct page_backed<Heap, decltype((void) Heap::PageBacked)>
+    : std::integral_constant<bool, (Heap::PageBacked != 0)> {};
+
+  /// Zero a recycled block. For large blocks of page-backed memory,
+  /// the whole pages inside it are handed back to the OS instead,
+  /// which is cheaper than writing them and leaves them uncommitted.
+  inline void zero_fill (void * ptr, size_t sz, bool pageBacked) {
+#if defined(__linux__)
+    enum { MadviseThreshold = 256 * 1024 };
+    if (pageBacked && (sz >= MadviseThreshold)) {
+      const auto start = reinterpret_cast<uintptr_t>(ptr);
+      const auto end = start + sz;
+      const auto pageStart = (start + CPUInfo::PageSize - 1) & ~(uintptr_t) (CPUInfo::PageSize - 1);
+      const auto pageEnd = end & ~(uintptr_t) (CPUInfo::PageSize - 1);
+      if (madvise (reinterpret_cast<void *>(pageStart), pageEnd - pageStart, MADV_DONTNEED) == 0) {
+	memset (ptr, 0, pageStart - start);
+	memset (reinterpret_cast<void *>(pageEnd), 0, end - pageEnd);
+	return;
+      }
+    }
+#else
+    (void) pageBacked;
+#endif
+    bulk_zero (ptr, sz);
+  }
+
+  /// True if Heap's own layer (the one providing its malloc) provides malloc_zeroed.
+  template <class Heap, class = void>
+  struct has_malloc_zeroed : std::false_type {};
+
+  template <class Heap>
+  struct has_malloc_zeroed<Heap, decltype((void) &Heap::malloc_zeroed, (void) &Heap::malloc)>
+    : same_layer<decltype(&Heap::malloc_zeroed), decltype(&Heap::malloc)> {};
+
+  namespace detail {
+
+    template <class Heap>
+    inline void * malloc_zeroed (Heap& heap, size_t sz, std::true_type)
+    {
+      return heap.malloc_zeroed (sz);
+    }
+
+    template <class Heap>
+    inline void * malloc_zeroed (Heap& heap, size_t sz, std::false_type)
+    {
+      void * ptr = heap.malloc (sz);
+      if (!zero_memory<Heap>::value && (ptr != nullptr)) {
+	bulk_zero (ptr, sz);
+      }
+      return ptr;
+    }
+
+  }
+
+  /// Allocate sz zero-filled bytes from heap, using heap.malloc_zeroed
+  /// if it has one (and skipping the memset if its memory is known zero).
+  template <class Heap>
+  inline void * malloc_zeroed (Heap& heap, size_t sz) {
+    return detail::malloc_zeroed (heap, sz, has_malloc_zeroed<Heap>());
+  }
+
+}
+
+#endif
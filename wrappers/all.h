@@ -2,3 +2,4 @@
 #include "macinterpose.h"
 #include "mmapwrapper.h"
 #include "stlallocator.h"
+#include "memoryresource.h"
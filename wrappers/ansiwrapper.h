@@ -14,6 +14,11 @@
 #endif
 
 #include "utility/cpp23compat.h"
+#include "utility/bulkcopy.h"
+#include "utility/goodsize.h"
+#include "utility/memalign.h"
+#include "utility/tryresize.h"
+#include "utility/zeromemory.h"
 
 /*
  * @class ANSIWrapper
@@ -32,15 +37,17 @@ namespace HL {
       return (b == 0) ? a : gcd(b, a % b);
     }
 
-  public:
-  
-    ANSIWrapper() {
-      static_assert(gcd(SuperHeap::Alignment, 8) == 8, "Alignment mismatch");
-    }
-    using SuperHeap::SuperHeap;
-
-    inline void * malloc (size_t sz) {
+    /// Apply the minimum size and alignment rules to a request size.
+    /// Returns false if the request is too large to satisfy.
+    static inline bool adjustSize (size_t& sz) {
 #if !defined(HL_NO_MALLOC_SIZE_CHECKS)
+#if HL_COMPACT_SMALL_OBJECTS
+      // Tiny objects only need 8-byte alignment.
+      if (sz <= 8) {
+	sz = 8;
+	return true;
+      }
+#endif
       static constexpr int alignment = 16; // safe for all platforms
       if (HL_EXPECT_FALSE(sz < alignment)) HL_UNLIKELY {
       	sz = alignment;
@@ -49,17 +56,56 @@ namespace HL {
       // currently does) provide more than enough slack to compensate for any
       // rounding below (in the alignment section).
       if (HL_EXPECT_FALSE(sz >> (sizeof(size_t) * CHAR_BIT - 1))) HL_UNLIKELY {
-	return 0;
+	return false;
       }
       // Enforce alignment requirements: round up allocation sizes if needed.
       // Enforce alignment.
       sz = (sz + alignment - 1UL) &
 	~(alignment - 1UL);
 #endif
+      return true;
+    }
+
+  public:
+  
+    ANSIWrapper() {
+      static_assert(gcd(SuperHeap::Alignment, 8) == 8, "Alignment mismatch");
+    }
+    using SuperHeap::SuperHeap;
+
+    inline void * malloc (size_t sz) {
+      if (HL_EXPECT_FALSE(!adjustSize (sz))) HL_UNLIKELY {
+	return 0;
+      }
       auto * ptr = SuperHeap::malloc (sz);
       return ptr;
     }
+
+    /// Allocate sz zero-filled bytes, skipping the memset when the
+    /// heap knows the memory is already zero.
+    inline void * malloc_zeroed (size_t sz) {
+      if (HL_EXPECT_FALSE(!adjustSize (sz))) HL_UNLIKELY {
+	return 0;
+      }
+      return HL::malloc_zeroed (static_cast<SuperHeap&>(*this), sz);
+    }
  
+    /// Allocate sz bytes aligned to alignment (a power of two).
+    inline void * memalign (size_t alignment, size_t sz) {
+      if (HL_EXPECT_FALSE(!is_power_of_two (alignment) || !adjustSize (sz))) HL_UNLIKELY {
+	return 0;
+      }
+      return HL::memalign (static_cast<SuperHeap&>(*this), alignment, sz);
+    }
+
+    /// The usable size a request for sz bytes would really get.
+    inline size_t good_size (size_t sz) {
+      if (HL_EXPECT_FALSE(!adjustSize (sz))) HL_UNLIKELY {
+	return sz;
+      }
+      return HL::good_size (static_cast<SuperHeap&>(*this), sz);
+    }
+
     inline void free (void * ptr) {
       if (HL_EXPECT_TRUE(ptr != 0)) HL_LIKELY {
 	SuperHeap::free (ptr);
@@ -79,11 +125,12 @@ namespace HL {
     }
     
     inline void * calloc (size_t s1, size_t s2) {
-      auto * ptr = (char *) malloc (s1 * s2);
-      if (HL_EXPECT_TRUE(ptr)) HL_LIKELY {
-      	memset (ptr, 0, s1 * s2);
+      const size_t n = s1 * s2;
+      // Check for overflow.
+      if (HL_EXPECT_FALSE(s2 && (s1 != n / s2))) HL_UNLIKELY {
+	return 0;
       }
-      return (void *) ptr;
+      return malloc_zeroed (n);
     }
   
     inline void * realloc (void * ptr, const size_t sz) {
@@ -100,6 +147,11 @@ namespace HL {
     	return ptr;
       }
 
+      // Resize in place if the heap allows.
+      if (try_resize (ptr, sz)) {
+	return ptr;
+      }
+
       // Allocate a new block of size sz.
       auto * buf = malloc (sz);
 
@@ -108,7 +160,7 @@ namespace HL {
 
       auto minSize = (objSize < sz) ? objSize : sz;
       if (HL_EXPECT_TRUE(buf)) HL_LIKELY {
-	memcpy (buf, ptr, minSize);
+	HL::bulk_copy (buf, ptr, minSize);
       }
 
       // Free the old block.
@@ -116,6 +168,15 @@ namespace HL {
       return buf;
     }
 
+    /// Grow or shrink an object in place, applying the same size
+    /// rounding as malloc; returns false if it would have to move.
+    inline bool try_resize (void * ptr, size_t sz) {
+      if (HL_EXPECT_FALSE((ptr == 0) || !adjustSize (sz))) HL_UNLIKELY {
+	return false;
+      }
+      return HL::try_resize (static_cast<SuperHeap&>(*this), ptr, sz);
+    }
+
     inline size_t getSize (void * ptr) {
       if (HL_EXPECT_TRUE(ptr)) HL_LIKELY {
 	return SuperHeap::getSize (ptr);
@@ -9,6 +9,10 @@
    allocated object. Header-based allocators, for example, need not
    apply.
 
+ - The padding around the aligned pointer is never reused. Heaps that
+   can do better should provide a memalign method instead (see
+   utility/memalign.h) and export it directly.
+
 */
 
 #include <stddef.h>
@@ -63,6 +63,7 @@
 
 #define ATTRIBUTE_EXPORT __attribute__((visibility("default")))
 
+#define WEAK_REDEF0(type,fname) ATTRIBUTE_EXPORT type fname(void) __THROW WEAK(custom##fname)
 #define WEAK_REDEF1(type,fname,arg1) ATTRIBUTE_EXPORT type fname(arg1) __THROW WEAK(custom##fname)
 #define WEAK_REDEF2(type,fname,arg1,arg2) ATTRIBUTE_EXPORT type fname(arg1,arg2) __THROW WEAK(custom##fname)
 #define WEAK_REDEF2_NOTHROW(type,fname,arg1,arg2) ATTRIBUTE_EXPORT type fname(arg1,arg2) WEAK(custom##fname)
@@ -79,12 +80,17 @@ extern "C" {
   WEAK_REDEF3(void *, reallocarray, void *, size_t, size_t);
   WEAK_REDEF2(void *, memalign, size_t, size_t);
   WEAK_REDEF3(int, posix_memalign, void **, size_t, size_t);
-#ifdef __USE_XOPEN2K // a work-around for an exception anomaly
-  //  WEAK_REDEF2_NOTHROW(void *, aligned_alloc, size_t, size_t);
-#else
   WEAK_REDEF2(void *, aligned_alloc, size_t, size_t);
-#endif
   WEAK_REDEF1(size_t, malloc_usable_size, void *);
+  WEAK_REDEF1(int, malloc_trim, size_t);
+  WEAK_REDEF0(void, malloc_stats);
+  WEAK_REDEF2(int, malloc_info, int, FILE *);
+#if defined(__GLIBC__)
+  WEAK_REDEF0(struct mallinfo, mallinfo);
+#if __GLIBC_PREREQ(2, 33)
+  WEAK_REDEF0(struct mallinfo2, mallinfo2);
+#endif
+#endif
   WEAK_REDEF1(char *, strdup, const char *);
   WEAK_REDEF2(char *, strndup, const char *, size_t);
   WEAK_REDEF1(void *, valloc, size_t);
@@ -133,12 +133,22 @@ class HeapWrapper {
     return ptr;
   }
 
+  static inline void* malloc_zeroed(size_t sz) {
+    auto ptr = HL::malloc_zeroed(*getHeap<CustomHeapType>(), sz);
+    assert(isValid(ptr));
+    return ptr;
+  }
+
   static inline void *memalign(size_t alignment, size_t sz) {
-    auto ptr = getHeap<CustomHeapType>()->memalign(alignment, sz);
+    auto ptr = HL::memalign(*getHeap<CustomHeapType>(), alignment, sz);
     assert(isValid(ptr));
     return ptr;
   }
 
+  static inline size_t good_size(size_t sz) {
+    return HL::good_size(*getHeap<CustomHeapType>(), sz);
+  }
+
   #if HL_USE_XXREALLOC
   static inline void* realloc(void * ptr, size_t sz) {
     auto buf = getHeap<CustomHeapType>()->realloc(ptr, sz);
@@ -200,6 +210,22 @@ class HeapWrapper {
     return 0;
   }
 
+  static inline bool try_resize(void * ptr, size_t sz) {
+    if (ptr) {
+      return HL::try_resize(*getHeap<CustomHeapType>(), ptr, sz);
+    }
+    return false;
+  }
+
+  static inline size_t trim(size_t pad) {
+    return HL::trim(*getHeap<CustomHeapType>(), pad);
+  }
+
+  static inline void collect_stats(HL::HeapStats * stats) {
+    stats->clear();
+    HL::collect_stats(*getHeap<CustomHeapType>(), *stats);
+  }
+
   static inline void xxmalloc_lock() {
     getHeap<CustomHeapType>()->lock();
   }
@@ -243,6 +269,27 @@ class HeapWrapper {
       return TheHeapWrapper::getSize(ptr);	\
     }\
     \
+    ATTRIBUTE_EXPORT int xxmalloc_try_resize(void *ptr, size_t sz) {\
+      return TheHeapWrapper::try_resize(ptr, sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT void *xxmalloc_zeroed(size_t sz) {\
+      return TheHeapWrapper::malloc_zeroed(sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT size_t xxmalloc_good_size(size_t sz) {\
+      return TheHeapWrapper::good_size(sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT size_t xxmalloc_trim(size_t pad) {\
+      return TheHeapWrapper::trim(pad);\
+    }\
+    \
+    ATTRIBUTE_EXPORT int xxmalloc_get_stats(HL::HeapStats * stats) {\
+      TheHeapWrapper::collect_stats(stats);\
+      return 1;\
+    }\
+    \
     ATTRIBUTE_EXPORT void xxmalloc_lock() {\
       TheHeapWrapper::xxmalloc_lock();\
     }\
@@ -280,6 +327,27 @@ class HeapWrapper {
       return TheHeapWrapper::getSize(ptr);	\
     }\
     \
+    ATTRIBUTE_EXPORT int xxmalloc_try_resize(void *ptr, size_t sz) {\
+      return TheHeapWrapper::try_resize(ptr, sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT void *xxmalloc_zeroed(size_t sz) {\
+      return TheHeapWrapper::malloc_zeroed(sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT size_t xxmalloc_good_size(size_t sz) {\
+      return TheHeapWrapper::good_size(sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT size_t xxmalloc_trim(size_t pad) {\
+      return TheHeapWrapper::trim(pad);\
+    }\
+    \
+    ATTRIBUTE_EXPORT int xxmalloc_get_stats(HL::HeapStats * stats) {\
+      TheHeapWrapper::collect_stats(stats);\
+      return 1;\
+    }\
+    \
     ATTRIBUTE_EXPORT void xxmalloc_lock() {\
       TheHeapWrapper::xxmalloc_lock();\
     }\
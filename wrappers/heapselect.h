@@ -0,0 +1,381 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_HEAPSELECT_H
+#define HL_HEAPSELECT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "utility/goodsize.h"
+#include "utility/heapstats.h"
+#include "utility/memalign.h"
+#include "utility/trim.h"
+#include "utility/tryresize.h"
+#include "utility/zeromemory.h"
+
+#if !defined ATTRIBUTE_EXPORT
+  #define ATTRIBUTE_EXPORT __attribute__((visibility("default")))
+#endif
+
+/**
+ * @file heapselect.h
+ * @brief Several compositions in one library, one chosen at startup.
+ *
+ * Each composition is compiled in full, with all of its layers
+ * inlined into a table of entry points (HeapFunctions). The first
+ * call into the library reads an environment variable, picks the
+ * table of the composition it names (or the first one), and installs
+ * it; from then on, xxmalloc and friends are a load and an indirect
+ * call into that table. Only the chosen composition's heap is ever
+ * constructed.
+ *
+ * Example:
+ * <TT>
+ *   struct Choices {<BR>
+ *     static constexpr const char * variable = "HL_HEAP";<BR>
+ *     static constexpr HL::HeapChoice choices[] = {<BR>
+ *       HL::heapChoice<KingsleyType> ("kingsley"),<BR>
+ *       HL::heapChoice<LeaType> ("lea") };<BR>
+ *   };<BR>
+ *   HEAP_SELECT(Choices)<BR>
+ * </TT>
+ */
+
+namespace HL {
+
+  /// The xx* entry points of one composition.
+  struct HeapFunctions {
+    void * (*malloc) (size_t);
+    void * (*malloc_zeroed) (size_t);
+    void   (*free) (void *);
+    void * (*memalign) (size_t, size_t);
+    size_t (*getSize) (void *);
+    int    (*try_resize) (void *, size_t);
+    size_t (*good_size) (size_t);
+    size_t (*trim) (size_t);
+    void   (*collect_stats) (HeapStats *);
+    void   (*lock) ();
+    void   (*unlock) ();
+#if HL_USE_XXREALLOC
+    void * (*realloc) (void *, size_t);
+#endif
+  };
+
+  namespace detail {
+
+    template <class Heap>
+    inline auto select_lock (Heap& heap, int) -> decltype(heap.lock()) {
+      heap.lock();
+    }
+
+    template <class Heap>
+    inline void select_lock (Heap&, long) {}
+
+    template <class Heap>
+    inline auto select_unlock (Heap& heap, int) -> decltype(heap.unlock()) {
+      heap.unlock();
+    }
+
+    template <class Heap>
+    inline void select_unlock (Heap&, long) {}
+
+  }
+
+  /**
+   * @class HeapEntryPoints
+   * @brief The HeapFunctions for one composition, over a single
+   * instance of Heap created on first use (and never destroyed).
+   */
+
+  template <class Heap>
+  class HeapEntryPoints {
+  public:
+
+    static inline Heap * getHeap() {
+      alignas(std::max_align_t) static char buf[sizeof(Heap)];
+      static Heap * heap = new (buf) Heap;
+      return heap;
+    }
+
+    static void * malloc (size_t sz) {
+      return getHeap()->malloc (sz);
+    }
+
+    static void * malloc_zeroed (size_t sz) {
+      return HL::malloc_zeroed (*getHeap(), sz);
+    }
+
+    static void free (void * ptr) {
+      getHeap()->free (ptr);
+    }
+
+    static void * memalign (size_t alignment, size_t sz) {
+      return HL::memalign (*getHeap(), alignment, sz);
+    }
+
+    static size_t getSize (void * ptr) {
+      return ptr ? getHeap()->getSize (ptr) : 0;
+    }
+
+    static int try_resize (void * ptr, size_t sz) {
+      return ptr ? HL::try_resize (*getHeap(), ptr, sz) : 0;
+    }
+
+    static size_t good_size (size_t sz) {
+      return HL::good_size (*getHeap(), sz);
+    }
+
+    static size_t trim (size_t pad) {
+      return HL::trim (*getHeap(), pad);
+    }
+
+    static void collect_stats (HeapStats * stats) {
+      stats->clear();
+      HL::collect_stats (*getHeap(), *stats);
+    }
+
+    static void lock() {
+      detail::select_lock (*getHeap(), 0);
+    }
+
+    static void unlock() {
+      detail::select_unlock (*getHeap(), 0);
+    }
+
+#if HL_USE_XXREALLOC
+    static void * realloc (void * ptr, size_t sz) {
+      return getHeap()->realloc (ptr, sz);
+    }
+#endif
+
+    static constexpr HeapFunctions functions = {
+      malloc, malloc_zeroed, free, memalign, getSize, try_resize,
+      good_size, trim, collect_stats, lock, unlock,
+#if HL_USE_XXREALLOC
+      realloc,
+#endif
+    };
+  };
+
+  template <class Heap>
+  constexpr HeapFunctions HeapEntryPoints<Heap>::functions;
+
+  /// A composition and the name that selects it.
+  struct HeapChoice {
+    const char * name;
+    const HeapFunctions * functions;
+  };
+
+  template <class Heap>
+  inline constexpr HeapChoice heapChoice (const char * name) {
+    return HeapChoice { name, &HeapEntryPoints<Heap>::functions };
+  }
+
+  /**
+   * @class HeapSelector
+   * @brief Binds the xx* entry points to the composition chosen by
+   * the environment variable Choices::variable.
+   *
+   * The active table starts out as a set of resolvers, which make the
+   * choice, install it, and forward the call; so no call ever has to
+   * check whether the choice has been made. Racing first calls all
+   * make the same choice.
+   */
+
+  template <class Choices>
+  class HeapSelector {
+  public:
+
+    static inline const HeapFunctions& functions() {
+      return *_active.load (std::memory_order_relaxed);
+    }
+
+    /// The name of the composition in use.
+    static const char * name() {
+      resolve();
+      return _chosen.load (std::memory_order_acquire)->name;
+    }
+
+  private:
+
+    static const HeapFunctions * resolve() {
+      auto * chosen = _chosen.load (std::memory_order_acquire);
+      if (chosen == nullptr) {
+	chosen = &Choices::choices[0];
+	// getenv does not allocate, so this is safe inside malloc.
+	const char * want = ::getenv (Choices::variable);
+	if (want != nullptr) {
+	  for (const auto& c : Choices::choices) {
+	    if (strcmp (c.name, want) == 0) {
+	      chosen = &c;
+	      break;
+	    }
+	  }
+	}
+	_chosen.store (chosen, std::memory_order_release);
+	_active.store (chosen->functions, std::memory_order_release);
+      }
+      return chosen->functions;
+    }
+
+    static void * resolve_malloc (size_t sz) {
+      return resolve()->malloc (sz);
+    }
+
+    static void * resolve_malloc_zeroed (size_t sz) {
+      return resolve()->malloc_zeroed (sz);
+    }
+
+    static void resolve_free (void * ptr) {
+      resolve()->free (ptr);
+    }
+
+    static void * resolve_memalign (size_t alignment, size_t sz) {
+      return resolve()->memalign (alignment, sz);
+    }
+
+    static size_t resolve_getSize (void * ptr) {
+      return resolve()->getSize (ptr);
+    }
+
+    static int resolve_try_resize (void * ptr, size_t sz) {
+      return resolve()->try_resize (ptr, sz);
+    }
+
+    static size_t resolve_good_size (size_t sz) {
+      return resolve()->good_size (sz);
+    }
+
+    static size_t resolve_trim (size_t pad) {
+      return resolve()->trim (pad);
+    }
+
+    static void resolve_collect_stats (HeapStats * stats) {
+      resolve()->collect_stats (stats);
+    }
+
+    static void resolve_lock() {
+      resolve()->lock();
+    }
+
+    static void resolve_unlock() {
+      resolve()->unlock();
+    }
+
+#if HL_USE_XXREALLOC
+    static void * resolve_realloc (void * ptr, size_t sz) {
+      return resolve()->realloc (ptr, sz);
+    }
+#endif
+
+    static constexpr HeapFunctions resolvers = {
+      resolve_malloc, resolve_malloc_zeroed, resolve_free, resolve_memalign,
+      resolve_getSize, resolve_try_resize, resolve_good_size, resolve_trim,
+      resolve_collect_stats, resolve_lock, resolve_unlock,
+#if HL_USE_XXREALLOC
+      resolve_realloc,
+#endif
+    };
+
+    static std::atomic<const HeapFunctions *> _active;
+    static std::atomic<const HeapChoice *> _chosen;
+  };
+
+  template <class Choices>
+  constexpr HeapFunctions HeapSelector<Choices>::resolvers;
+
+  template <class Choices>
+  std::atomic<const HeapFunctions *> HeapSelector<Choices>::_active (&HeapSelector<Choices>::resolvers);
+
+  template <class Choices>
+  std::atomic<const HeapChoice *> HeapSelector<Choices>::_chosen (nullptr);
+
+}
+
+#if HL_USE_XXREALLOC
+#define HL_HEAP_SELECT_XXREALLOC(Selector)\
+    ATTRIBUTE_EXPORT void * xxrealloc(void * ptr, size_t sz) {\
+      return Selector::functions().realloc(ptr, sz);\
+    }
+#else
+#define HL_HEAP_SELECT_XXREALLOC(Selector)
+#endif
+
+/// Define the xx* entry points over HL::HeapSelector<Choices>.
+#define HEAP_SELECT(Choices)\
+  typedef HL::HeapSelector<Choices> TheHeapSelector;\
+  extern "C" {\
+    ATTRIBUTE_EXPORT void * xxmalloc(size_t sz) {\
+      return TheHeapSelector::functions().malloc(sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT void xxfree(void * ptr) {\
+      TheHeapSelector::functions().free(ptr);\
+    }\
+    \
+    ATTRIBUTE_EXPORT void xxfree_sized(void * ptr, size_t) {\
+      TheHeapSelector::functions().free(ptr);\
+    }\
+    \
+    ATTRIBUTE_EXPORT void xxfree_aligned_sized(void * ptr, size_t, size_t) {\
+      TheHeapSelector::functions().free(ptr);\
+    }\
+    \
+    ATTRIBUTE_EXPORT void * xxmemalign(size_t alignment, size_t sz) {\
+      return TheHeapSelector::functions().memalign(alignment, sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT size_t xxmalloc_usable_size(void * ptr) {\
+      return TheHeapSelector::functions().getSize(ptr);\
+    }\
+    \
+    ATTRIBUTE_EXPORT int xxmalloc_try_resize(void * ptr, size_t sz) {\
+      return TheHeapSelector::functions().try_resize(ptr, sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT void * xxmalloc_zeroed(size_t sz) {\
+      return TheHeapSelector::functions().malloc_zeroed(sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT size_t xxmalloc_good_size(size_t sz) {\
+      return TheHeapSelector::functions().good_size(sz);\
+    }\
+    \
+    ATTRIBUTE_EXPORT size_t xxmalloc_trim(size_t pad) {\
+      return TheHeapSelector::functions().trim(pad);\
+    }\
+    \
+    ATTRIBUTE_EXPORT int xxmalloc_get_stats(HL::HeapStats * stats) {\
+      TheHeapSelector::functions().collect_stats(stats);\
+      return 1;\
+    }\
+    \
+    ATTRIBUTE_EXPORT void xxmalloc_lock() {\
+      TheHeapSelector::functions().lock();\
+    }\
+    \
+    ATTRIBUTE_EXPORT void xxmalloc_unlock() {\
+      TheHeapSelector::functions().unlock();\
+    }\
+    HL_HEAP_SELECT_XXREALLOC(TheHeapSelector)\
+  }
+
+#endif
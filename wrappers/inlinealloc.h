@@ -0,0 +1,214 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_INLINEALLOC_H
+#define HL_INLINEALLOC_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <dlfcn.h>
+#endif
+
+#include "heaps/threads/threadcacheabi.h"
+#include "utility/cpp23compat.h"
+
+/**
+ * @file inlinealloc.h
+ * @brief Fixed-size allocation that inlines into the caller.
+ *
+ * <TT>HL::allocate<Size>()</TT> and <TT>HL::deallocate<Size>(p)</TT>
+ * pick the size class at compile time and pop or push the calling
+ * thread's cache in the allocator itself, which an exporting
+ * ThreadCacheHeap publishes through an initial-exec TLS pointer (see
+ * threadcacheabi.h). The preloaded scalable allocator (and libselect's
+ * threadcached mode) export theirs. Each thread looks up the address
+ * of that pointer once and keeps it in an initial-exec TLS slot of its
+ * own, so a hit is two loads, a pop and a count update, with no call
+ * at all. The objects are the allocator's, so malloc_trim flushes
+ * them and malloc_stats counts them like any others.
+ *
+ * Everything else goes to ::malloc and ::free: sizes above
+ * InlineMaxSize, an empty list (malloc refills it, so the next
+ * allocate hits), a full one (free sends half of it back), a thread
+ * whose cache is not set up yet, and programs running over an
+ * allocator that exports no cache. The lookup uses dlsym, so link
+ * with -ldl on systems whose libc does not provide it.
+ *
+ * An object from allocate<Size>() may also be passed to free(). The
+ * converse does not hold: deallocate<Size>() only accepts objects from
+ * allocate<Size>() (or allocate<S> with S in the same class).
+ *
+ * Example:
+ * <TT>
+ *   auto * n = HL::make<Node>(key, value);<BR>
+ *   HL::destroy (n);<BR>
+ * </TT>
+ */
+
+namespace HL {
+
+  namespace detail {
+
+    /// The size class for sz: 16, 32, ... bytes (powers of two).
+    inline constexpr int inlineSizeClass (size_t sz) {
+      int c = 0;
+      while ((c < ThreadCacheExportedClasses - 1) && (((size_t) ThreadCacheMinClassSize << c) < sz)) {
+	c++;
+      }
+      return c;
+    }
+
+    inline constexpr size_t inlineClassSize (int c) {
+      return (size_t) ThreadCacheMinClassSize << c;
+    }
+
+#if !defined(_WIN32)
+
+    /**
+     * @class InlineCacheSlot
+     * @brief Where the calling thread finds the allocator's lists.
+     *
+     * slot is null until a thread's first call, then holds the address
+     * of the allocator's pointer to that thread's lists (or of a null
+     * pointer, if no allocator exports one).
+     */
+
+    template <int Dummy = 0>
+    class InlineCacheSlot {
+    public:
+
+      static inline ThreadCacheList * lists() {
+	auto ** s = slot;
+	if (HL_EXPECT_FALSE(s == nullptr)) HL_UNLIKELY {
+	  s = lookup();
+	}
+	return *s;
+      }
+
+    private:
+
+      typedef ThreadCacheList ** (*SlotFunction)();
+
+      __attribute__((noinline)) static ThreadCacheList ** lookup() {
+	static ThreadCacheList * none = nullptr;
+	static const SlotFunction f =
+	  reinterpret_cast<SlotFunction>(dlsym (RTLD_DEFAULT, HL_THREAD_CACHE_SLOT_FUNCTION));
+	slot = (f != nullptr) ? f() : &none;
+	return slot;
+      }
+
+      static __thread ThreadCacheList ** slot __attribute__((tls_model ("initial-exec")));
+    };
+
+    template <int Dummy>
+    __thread ThreadCacheList ** InlineCacheSlot<Dummy>::slot = nullptr;
+
+#endif
+
+    inline ThreadCacheList * inlineCache() {
+#if !defined(_WIN32)
+      return InlineCacheSlot<>::lists();
+#else
+      return nullptr;
+#endif
+    }
+
+  }
+
+  /// The largest size served from the thread cache.
+  enum { InlineMaxSize = detail::inlineClassSize (ThreadCacheExportedClasses - 1) };
+
+  /// Allocate Size bytes (aligned as malloc would).
+  template <size_t Size>
+  inline void * allocate() {
+    if (Size > (size_t) InlineMaxSize) {
+      return ::malloc (Size);
+    }
+    constexpr int c = detail::inlineSizeClass (Size);
+    auto * lists = detail::inlineCache();
+    if (HL_EXPECT_TRUE(lists != nullptr)) HL_LIKELY {
+      auto& list = lists[c];
+      auto * e = list.head;
+      if (HL_EXPECT_TRUE(e != nullptr)) HL_LIKELY {
+	list.head = e->next;
+	list.count--;
+	return e;
+      }
+    }
+    // Ask for the whole class, so the object can go back on its list.
+    return ::malloc (detail::inlineClassSize (c));
+  }
+
+  /// Free an object obtained from allocate<Size>().
+  template <size_t Size>
+  inline void deallocate (void * ptr) {
+    if ((Size > (size_t) InlineMaxSize) || (ptr == nullptr)) {
+      ::free (ptr);
+      return;
+    }
+    constexpr int c = detail::inlineSizeClass (Size);
+    auto * lists = detail::inlineCache();
+    if (HL_EXPECT_TRUE(lists != nullptr)) HL_LIKELY {
+      auto& list = lists[c];
+      if (HL_EXPECT_TRUE(list.count < list.limit)) HL_LIKELY {
+	auto * e = reinterpret_cast<ThreadCacheEntry *>(ptr);
+	e->next = list.head;
+	list.head = e;
+	list.count++;
+	return;
+      }
+    }
+    ::free (ptr);
+  }
+
+  /// Allocate and construct a T; returns nullptr if out of memory.
+  template <class T, class... Args>
+  inline T * make (Args&&... args) {
+    static_assert (alignof(T) <= alignof(std::max_align_t),
+		   "HL::make only provides malloc alignment.");
+    void * ptr = allocate<sizeof(T)>();
+    if (ptr == nullptr) {
+      return nullptr;
+    }
+#if defined(__cpp_exceptions)
+    try {
+      return new (ptr) T (std::forward<Args>(args)...);
+    } catch (...) {
+      deallocate<sizeof(T)>(ptr);
+      throw;
+    }
+#else
+    return new (ptr) T (std::forward<Args>(args)...);
+#endif
+  }
+
+  /// Destroy and free an object from HL::make<T>.
+  template <class T>
+  inline void destroy (T * obj) {
+    if (obj) {
+      obj->~T();
+      deallocate<sizeof(T)>(obj);
+    }
+  }
+
+}
+
+#endif
@@ -65,6 +65,10 @@ extern "C" {
   // Takes a pointer and returns how much space it holds.
   size_t xxmalloc_usable_size (void *);
 
+  // The size a request would really get (heaps that do not round
+  // requests up need not define it).
+  __attribute__((weak)) size_t xxmalloc_good_size (size_t sz) { return sz; }
+
   // Locks the heap(s), used prior to any invocation of fork().
   void xxmalloc_lock ();
 
@@ -108,8 +112,7 @@ extern "C" {
   }
 
   size_t replace_malloc_good_size (size_t sz) {
-    // Just trust the size, Luke
-    return sz ? sz : 1;
+    return xxmalloc_good_size (sz ? sz : 1);
   }
 
   static void * _extended_realloc (void * ptr, size_t sz, bool isReallocf) 
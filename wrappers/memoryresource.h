@@ -0,0 +1,236 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+#ifndef HL_MEMORYRESOURCE_H
+#define HL_MEMORYRESOURCE_H
+
+#if defined(__has_include)
+#if (__cplusplus >= 201703L) && __has_include(<memory_resource>)
+#define HL_HAVE_MEMORY_RESOURCE 1
+#endif
+#endif
+
+#if defined(HL_HAVE_MEMORY_RESOURCE)
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+
+#include "heaps/buildingblock/freelistheap.h"
+#include "heaps/general/kingsleyheap.h"
+#include "heaps/special/zoneheap.h"
+#include "heaps/top/mmapheap.h"
+#include "heaps/utility/nullheap.h"
+#include "utility/goodsize.h"
+#include "utility/memalign.h"
+#include "wrappers/mallocinfo.h"
+
+/**
+ * @file memoryresource.h
+ * @brief Heap Layers heaps as C++17 polymorphic memory resources.
+ *
+ * STLAllocator makes the heap part of the container's type. A
+ * std::pmr container instead takes a <TT>memory_resource *</TT>, so
+ * containers backed by different heaps share one type and can be
+ * handed across interfaces that know nothing of Heap Layers:
+ *
+ * <TT>
+ *   HL::PoolResource<> pool;<BR>
+ *   std::pmr::vector<int> v (&pool);<BR>
+ * </TT>
+ *
+ * (Available when compiling as C++17 or later.)
+ */
+
+namespace HL {
+
+  namespace detail {
+
+    // Heaps that take the object size on free (because they keep no
+    // header) are given the size they actually allocated.
+
+    template <class Heap>
+    inline auto resource_free (Heap& heap, void * ptr, size_t sz, int)
+      -> decltype(heap.free (ptr, sz), void())
+    {
+      heap.free (ptr, HL::good_size (heap, sz));
+    }
+
+    template <class Heap>
+    inline void resource_free (Heap& heap, void * ptr, size_t, long)
+    {
+      heap.free (ptr);
+    }
+
+    /// Holds a resource's own heap, so that it is constructed before
+    /// (and destroyed after) the MemoryResource that refers to it.
+    template <class Heap>
+    class ResourceHeapHolder {
+    protected:
+      Heap _ownHeap;
+    };
+
+    /**
+     * @class PoolHeap
+     * @brief Power-of-two free lists carved from a zone, without headers.
+     *
+     * Objects carry no size, so they must be freed with their size
+     * (as memory resources are); every object stays in its class
+     * until the whole pool is released.
+     */
+
+    template <class SuperHeap, size_t ChunkSize>
+    class PoolHeap :
+      public StrictSegHeap<Kingsley::NUMBINS,
+			   Kingsley::size2Class,
+			   Kingsley::class2Size,
+			   FreelistHeap<NullHeap<SuperHeap>>,
+			   ZoneHeap<SuperHeap, ChunkSize>>
+    {
+    public:
+      /// Forget every object and return the zone's arenas.
+      void release() {
+	this->clear();
+	this->bigheap.clear();
+      }
+    };
+
+  }
+
+  /**
+   * @class MemoryResource
+   * @brief A std::pmr::memory_resource that allocates from a Heap Layers heap.
+   *
+   * Requests up to malloc alignment go to malloc (rounded up to the
+   * alignment, so that small power-of-two classes stay aligned),
+   * stricter ones to memalign. Two resources are equal when they
+   * allocate from the same heap object.
+   */
+
+  template <class Heap>
+  class MemoryResource : public std::pmr::memory_resource {
+  public:
+
+    explicit MemoryResource (Heap& heap)
+      : _heap (heap)
+    {}
+
+    MemoryResource (const MemoryResource&) = default;
+
+    Heap& heap() const {
+      return _heap;
+    }
+
+  protected:
+
+    void * do_allocate (size_t bytes, size_t alignment) override {
+      bytes = requestSize (bytes, alignment);
+      void * ptr;
+      if (HL_EXPECT_TRUE(alignment <= (size_t) MallocInfo::Alignment)) HL_LIKELY {
+	ptr = _heap.malloc (bytes);
+      } else {
+	ptr = HL::memalign (_heap, alignment, bytes);
+      }
+      if (HL_EXPECT_FALSE(ptr == nullptr)) HL_UNLIKELY {
+	throw std::bad_alloc();
+      }
+      return ptr;
+    }
+
+    void do_deallocate (void * ptr, size_t bytes, size_t alignment) override {
+      detail::resource_free (_heap, ptr, requestSize (bytes, alignment), 0);
+    }
+
+    bool do_is_equal (const std::pmr::memory_resource& other) const noexcept override {
+      if (this == &other) {
+	return true;
+      }
+      auto * o = dynamic_cast<const MemoryResource *>(&other);
+      return (o != nullptr) && (&o->_heap == &_heap);
+    }
+
+  private:
+
+    static inline size_t requestSize (size_t bytes, size_t alignment) {
+      return (bytes < alignment) ? alignment : bytes;
+    }
+
+    Heap& _heap;
+  };
+
+  /**
+   * @class MonotonicResource
+   * @brief A resource whose deallocate does nothing; memory comes back
+   * all at once, from release() or the destructor.
+   *
+   * Like std::pmr::monotonic_buffer_resource, but carved from a
+   * ZoneHeap (which sizes its arenas by the zone.chunk_size tunable).
+   */
+
+  template <class SuperHeap = SizedMmapHeap, size_t ChunkSize = 65536>
+  class MonotonicResource :
+    private detail::ResourceHeapHolder<ZoneHeap<SuperHeap, ChunkSize>>,
+    public MemoryResource<ZoneHeap<SuperHeap, ChunkSize>>
+  {
+  public:
+
+    MonotonicResource()
+      : MemoryResource<ZoneHeap<SuperHeap, ChunkSize>> (this->_ownHeap)
+    {}
+
+    MonotonicResource (const MonotonicResource&) = delete;
+    MonotonicResource& operator= (const MonotonicResource&) = delete;
+
+    void release() {
+      this->_ownHeap.clear();
+    }
+  };
+
+  /**
+   * @class PoolResource
+   * @brief A single-threaded pool of power-of-two free lists.
+   *
+   * Like std::pmr::unsynchronized_pool_resource: freed objects are
+   * reused by later requests of the same class, and all memory is
+   * returned by release() or the destructor. Objects have no headers;
+   * the size passed to deallocate picks the free list.
+   */
+
+  template <class SuperHeap = SizedMmapHeap, size_t ChunkSize = 65536>
+  class PoolResource :
+    private detail::ResourceHeapHolder<detail::PoolHeap<SuperHeap, ChunkSize>>,
+    public MemoryResource<detail::PoolHeap<SuperHeap, ChunkSize>>
+  {
+  public:
+
+    PoolResource()
+      : MemoryResource<detail::PoolHeap<SuperHeap, ChunkSize>> (this->_ownHeap)
+    {}
+
+    PoolResource (const PoolResource&) = delete;
+    PoolResource& operator= (const PoolResource&) = delete;
+
+    void release() {
+      this->_ownHeap.release();
+    }
+  };
+
+}
+
+#endif
+
+#endif
@@ -25,6 +25,8 @@
 
 #include <memory> // STL
 
+#include "utility/goodsize.h"
+
 // Somewhere someone is defining a max macro (on Windows),
 // and this is a problem -- solved by undefining it.
 
@@ -50,6 +52,17 @@ using namespace std;
 
 namespace HL {
 
+#if defined(__cpp_lib_allocate_at_least)
+  using std::allocation_result;
+#else
+  /// The result of allocate_at_least (std::allocation_result from C++23).
+  template <class Pointer, class SizeType = std::size_t>
+  struct allocation_result {
+    Pointer ptr;
+    SizeType count;
+  };
+#endif
+
 template <class T, class Super>
 class STLAllocator : public Super {
 public:
@@ -118,6 +131,18 @@ public:
   }
 #endif
 
+  /// Allocate room for at least n objects, reporting how many
+  /// actually fit once the heap has rounded the request up (to its
+  /// size class, say), so that growable containers can use the slack.
+  inline allocation_result<pointer, size_type> allocate_at_least (size_type n) {
+    if (n == 0) {
+      return { nullptr, 0 };
+    }
+    const size_t sz = HL::good_size (static_cast<Super&>(*this), sizeof(T) * n);
+    auto * ptr = reinterpret_cast<pointer>(Super::malloc (sz));
+    return { ptr, ptr ? sz / sizeof(T) : 0 };
+  }
+
   inline void deallocate (void * p, size_type) {
     Super::free (p);
   }
@@ -0,0 +1,178 @@
+// -*- C++ -*-
+
+/*
+
+  Heap Layers: An Extensible Memory Allocation Infrastructure
+
+  Copyright (C) 2000-2020 by Emery Berger
+  http://www.emeryberger.com
+  emery@cs.umass.edu
+
+  Heap Layers is distributed under the terms of the Apache 2.0 license.
+
+  You may obtain a copy of the License at
+  http://www.apache.org/licenses/LICENSE-2.0
+
+*/
+
+/*
+ * Checks HL::allocate and HL::deallocate, and times them against
+ * malloc and free. Over an allocator that exports its thread caches
+ * (the scalable example, or libselect with HL_HEAP=threadcached), it
+ * also checks that inline code and malloc share one cache: an object
+ * deallocated inline is the next one malloc returns, and vice versa.
+ * Over any other malloc, every call simply goes to malloc and free.
+ *
+ *   g++ -std=c++14 -O2 -I.. testinlinealloc.cpp -o testinlinealloc -lpthread -ldl
+ *   LD_PRELOAD=/path/to/libscalable.so ./testinlinealloc [threads]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <malloc.h>
+
+#include "inlinealloc.h"
+#include "utility/timer.h"
+
+static const int Rounds = 2000000;
+
+struct Node {
+  Node (long k) : key (k), next (nullptr) {}
+  long key;
+  Node * next;
+  char payload[40];
+};
+
+static bool fail (const char * what) {
+  printf ("FAILED: %s\n", what);
+  return false;
+}
+
+template <size_t Size>
+static bool checkSize() {
+  void * objs[100];
+  for (auto& p : objs) {
+    p = HL::allocate<Size>();
+    if ((p == nullptr) || (malloc_usable_size (p) < Size)) {
+      return fail ("allocate");
+    }
+    memset (p, 0xab, Size);
+  }
+  for (auto& p : objs) {
+    HL::deallocate<Size> (p);
+  }
+  // An inline object may also go to free().
+  void * p = HL::allocate<Size>();
+  free (p);
+  return true;
+}
+
+/// Over an exporting allocator, both paths use the same lists.
+static bool checkShared() {
+  void * volatile p = malloc (64);	// Sets up this thread's cache.
+  free (p);
+  if (HL::detail::inlineCache() == nullptr) {
+    printf ("no exported thread cache: inline calls go to malloc\n");
+    return true;
+  }
+  void * a = HL::allocate<64>();
+  HL::deallocate<64> (a);
+  void * volatile b = malloc (64);
+  if (b != a) {
+    return fail ("malloc did not reuse an inline-freed object");
+  }
+  free (b);
+  void * c = HL::allocate<64>();
+  if (c != b) {
+    return fail ("allocate did not reuse a freed object");
+  }
+  HL::deallocate<64> (c);
+  printf ("exported thread cache: shared with malloc\n");
+  return true;
+}
+
+/// Each thread builds and tears down lists, handing every other one
+/// to its neighbour to free (with destroy).
+static bool checkThreads (int nthreads) {
+  std::vector<std::thread> threads;
+  std::vector<Node *> handoff (nthreads, nullptr);
+  std::vector<int> bad (nthreads, 0);
+  for (int t = 0; t < nthreads; t++) {
+    threads.emplace_back ([&, t] {
+	for (int r = 0; r < 200; r++) {
+	  Node * head = nullptr;
+	  for (long i = 0; i < 1000; i++) {
+	    Node * n = HL::make<Node> (i);
+	    n->next = head;
+	    head = n;
+	  }
+	  long expect = 999;
+	  for (Node * n = head; n != nullptr; n = n->next) {
+	    bad[t] |= (n->key != expect--);
+	  }
+	  if (r & 1) {
+	    while (head) {
+	      Node * n = head;
+	      head = n->next;
+	      HL::destroy (n);
+	    }
+	  } else {
+	    // Freed by another thread (through free, not destroy).
+	    handoff[t] = head;
+	  }
+	}
+      });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (int t = 0; t < nthreads; t++) {
+    for (Node * n = handoff[t]; n != nullptr; ) {
+      Node * next = n->next;
+      n->~Node();
+      free (n);
+      n = next;
+    }
+    if (bad[t]) {
+      return fail ("lost an update");
+    }
+  }
+  return true;
+}
+
+template <class Alloc, class Free>
+static double timeit (Alloc alloc, Free release) {
+  void * objs[16];
+  HL::Timer t;
+  t.start();
+  for (int r = 0; r < Rounds / 16; r++) {
+    for (auto& p : objs) {
+      p = alloc();
+    }
+    for (auto& p : objs) {
+      release (p);
+    }
+  }
+  t.stop();
+  return (double) t * 1e9 / Rounds;
+}
+
+int main (int argc, char * argv[]) {
+  const int nthreads = (argc > 1) ? atoi (argv[1]) : 4;
+  if (!checkShared() ||
+      !checkSize<1>() || !checkSize<16>() || !checkSize<24>() ||
+      !checkSize<100>() || !checkSize<2048>() || !checkSize<2049>() ||
+      !checkSize<100000>() ||
+      !checkThreads (nthreads)) {
+    return 1;
+  }
+  printf ("malloc/free            %6.1f ns per pair\n",
+	  timeit ([] { return malloc (48); }, [] (void * p) { free (p); }));
+  printf ("allocate/deallocate    %6.1f ns per pair\n",
+	  timeit ([] { return HL::allocate<48>(); }, [] (void * p) { HL::deallocate<48> (p); }));
+  return 0;
+}
@@ -22,7 +22,10 @@
  */
 
 #include "threads/cpuinfo.h"
+#include "utility/bulkcopy.h"
 #include "utility/cpp23compat.h"
+#include "utility/heapstats.h"
+#include "utility/tunables.h"
 
 #include <string.h> // for memcpy and memset
 #include <stdlib.h> // size_t
@@ -47,6 +50,24 @@ extern "C" {
   // Takes a pointer and returns how much space it holds.
   size_t xxmalloc_usable_size (void *);
 
+  // Optional: resizes an object in place, returning nonzero on success.
+  int xxmalloc_try_resize (void *, size_t);
+
+  // Optional: allocates zero-filled memory (skipping the clearing of
+  // memory the heap knows is already zero).
+  void * xxmalloc_zeroed (size_t);
+
+  // Optional: the size a request would really get (its size class).
+  size_t xxmalloc_good_size (size_t);
+
+  // Optional: gives cached memory back (leaving pad bytes of slack),
+  // returning the number of bytes released.
+  size_t xxmalloc_trim (size_t);
+
+  // Optional: fills in a snapshot of the heap's statistics, returning
+  // nonzero if the heap supports them.
+  int xxmalloc_get_stats (HL::HeapStats *);
+
   // Locks the heap(s), used prior to any invocation of fork().
   void xxmalloc_lock();
 
@@ -114,6 +135,8 @@ extern "C" {
 #define CUSTOM_MALLOC_GET_STATE(p)  CUSTOM_PREFIX(malloc_get_state)(p)
 #define CUSTOM_MALLOC_SET_STATE(p)  CUSTOM_PREFIX(malloc_set_state)(p)
 #define CUSTOM_MALLINFO(a)          CUSTOM_PREFIX(mallinfo)(a)
+#define CUSTOM_MALLINFO2(a)         CUSTOM_PREFIX(mallinfo2)(a)
+#define CUSTOM_MALLOC_INFO(o,f)     CUSTOM_PREFIX(malloc_info)(o,f)
 
 #if defined(_WIN32)
 #define MYCDECL __cdecl
@@ -196,6 +219,17 @@ extern "C" __attribute__((noinline)) void * my_dlsym(void * handle, const char *
   return ptr;
 }
 
+#if !defined(_WIN32)
+// Heaps that cannot do better than malloc + memset need not define this.
+extern "C" __attribute__((weak)) void * xxmalloc_zeroed (size_t sz) {
+  void * ptr = xxmalloc(sz);
+  if (HL_EXPECT_TRUE(ptr)) HL_LIKELY {
+    HL::bulk_zero (ptr, sz);
+  }
+  return ptr;
+}
+#endif
+
 extern "C" FLATTEN void * MYCDECL CUSTOM_CALLOC(size_t nelem, size_t elsize)
 {
   // Reject calls from dlsym so it uses its own internal buffer.
@@ -210,12 +244,16 @@ extern "C" FLATTEN void * MYCDECL CUSTOM_CALLOC(size_t nelem, size_t elsize)
     return nullptr;
   }
 
+#if !defined(_WIN32)
+  void * ptr = xxmalloc_zeroed(n);
+#else
   void * ptr = xxmalloc(n);
 
   // Zero out the malloc'd block.
   if (HL_EXPECT_TRUE(ptr)) HL_LIKELY {
-    memset (ptr, 0, n);
+    HL::bulk_zero (ptr, n);
   }
+#endif
   return ptr;
 }
 
@@ -286,8 +324,26 @@ extern "C" void MYCDECL CUSTOM_CFREE (void * ptr)
   }
 }
 
+#if !defined(_WIN32)
+// Heaps that cannot resize objects in place need not define this.
+extern "C" __attribute__((weak)) int xxmalloc_try_resize (void *, size_t) {
+  return 0;
+}
+#endif
+
+#if !defined(_WIN32)
+// Heaps that do not round requests up need not define this.
+extern "C" __attribute__((weak)) size_t xxmalloc_good_size (size_t sz) {
+  return sz;
+}
+#endif
+
 extern "C" size_t MYCDECL CUSTOM_GOODSIZE (size_t sz) {
+#if !defined(_WIN32)
+  return xxmalloc_good_size (sz ? sz : 1);
+#else
   return sz ? sz : 1;
+#endif
 }
 
 extern "C" void * MYCDECL CUSTOM_REALLOC (void * ptr, size_t sz)
@@ -314,6 +370,13 @@ extern "C" void * MYCDECL CUSTOM_REALLOC (void * ptr, size_t sz)
 
   size_t objSize = CUSTOM_GETSIZE(ptr);
 
+#if !defined(_WIN32)
+  // Grow or shrink in place if the heap can.
+  if (xxmalloc_try_resize(ptr, sz)) {
+    return ptr;
+  }
+#endif
+
   void * buf = xxmalloc(sz);
 
   if (HL_EXPECT_FALSE(!buf)) HL_UNLIKELY {
@@ -330,7 +393,7 @@ extern "C" void * MYCDECL CUSTOM_REALLOC (void * ptr, size_t sz)
   // Copy the contents of the original object
   // up to the size of the new block.
   size_t minSize = (objSize < sz) ? objSize : sz;
-  memcpy(buf, ptr, minSize);
+  HL::bulk_copy(buf, ptr, minSize);
 
   // Free the old block.
   CUSTOM_FREE(ptr);
@@ -402,14 +465,29 @@ extern "C" int  CUSTOM_MALLOPT (int /* param */, int /* value */) {
   return 1; // success.
 }
 
-extern "C" int xxmalloc_TRIM(size_t /* pad */) {
-  // NOP.
-  return 0; // no memory returned to OS.
+// Read and/or change a runtime tunable (see utility/tunables.h).
+// Returns 0 on success, ENOENT for an unknown name, or EINVAL.
+extern "C" ATTRIBUTE_EXPORT int hl_ctl (const char * name, size_t * oldp, const size_t * newp) {
+  return HL::Tunables::ctl (name, oldp, newp);
 }
 
-extern "C" void xxmalloc_STATS() {
-  // NOP.
+#if !defined(_WIN32)
+// Heaps that cache nothing need not define this.
+extern "C" __attribute__((weak)) size_t xxmalloc_trim (size_t) {
+  return 0;
 }
+#endif
+
+extern "C" int CUSTOM_MALLOC_TRIM (size_t pad) {
+#if !defined(_WIN32)
+  // As with glibc, report whether any memory was released.
+  return (xxmalloc_trim (pad) > 0);
+#else
+  (void) pad;
+  return 0;
+#endif
+}
+
 
 extern "C" void * xxmalloc_GET_STATE() {
   return nullptr; // always returns "error".
@@ -419,23 +497,95 @@ extern "C" int xxmalloc_SET_STATE(void * /* ptr */) {
   return 0; // success.
 }
 
+#if !defined(_WIN32)
+// Heaps that keep no statistics need not define this.
+extern "C" __attribute__((weak)) int xxmalloc_get_stats (HL::HeapStats * stats) {
+  stats->clear();
+  return 0;
+}
+
+// The statistics are only gathered when asked for. Each caller gets
+// its own snapshot (on the stack, not allocated), so concurrent
+// callers do not race.
+static HL::HeapStats collectHeapStats() {
+  HL::HeapStats stats;
+  xxmalloc_get_stats (&stats);
+  return stats;
+}
+
+extern "C" void CUSTOM_MALLOC_STATS() {
+  const auto s = collectHeapStats();
+  fprintf (stderr, "Arena 0:\n");
+  fprintf (stderr, "system bytes     = %10zu\n", s.totalBytes());
+  fprintf (stderr, "in use bytes     = %10zu\n", s.inUseBytes());
+  fprintf (stderr, "free bytes       = %10zu (%zu objects)\n", s.freeBytes, s.freeObjects);
+  fprintf (stderr, "unused bytes     = %10zu\n", s.unusedBytes);
+  fprintf (stderr, "thread cache     = %10zu\n", s.threadCacheBytes);
+  fprintf (stderr, "mmapped bytes    = %10zu\n", s.mmapBytes);
+  for (int i = 0; i < s.numClasses; i++) {
+    if (s.classFreeObjects[i] != 0) {
+      fprintf (stderr, "  class %3d (<= %zu bytes): %zu free objects, %zu bytes\n",
+	       i, s.classSize[i], s.classFreeObjects[i], s.classFreeBytes[i]);
+    }
+  }
+}
+
+extern "C" int CUSTOM_MALLOC_INFO (int options, FILE * fp) {
+  if (options != 0) {
+    return EINVAL;
+  }
+  const auto s = collectHeapStats();
+  fprintf (fp, "<malloc version=\"1\">\n<heap nr=\"0\">\n<sizes>\n");
+  size_t from = 0;
+  for (int i = 0; i < s.numClasses; i++) {
+    if (s.classFreeObjects[i] != 0) {
+      fprintf (fp, "  <size from=\"%zu\" to=\"%zu\" total=\"%zu\" count=\"%zu\"/>\n",
+	       from, s.classSize[i], s.classFreeBytes[i], s.classFreeObjects[i]);
+    }
+    from = s.classSize[i] + 1;
+  }
+  fprintf (fp, "</sizes>\n");
+  fprintf (fp, "<total type=\"bins\" count=\"%zu\" size=\"%zu\"/>\n", s.freeObjects, s.freeBytes);
+  fprintf (fp, "<total type=\"unused\" size=\"%zu\"/>\n", s.unusedBytes);
+  fprintf (fp, "<total type=\"thread-cache\" size=\"%zu\"/>\n", s.threadCacheBytes);
+  fprintf (fp, "<total type=\"mmap\" size=\"%zu\"/>\n", s.mmapBytes);
+  fprintf (fp, "<system type=\"current\" size=\"%zu\"/>\n", s.totalBytes());
+  fprintf (fp, "<aspace type=\"total\" size=\"%zu\"/>\n", s.arenaBytes);
+  fprintf (fp, "</heap>\n</malloc>\n");
+  return 0;
+}
+#endif
+
 // NOTE-- MUSL defines GNUC for some reason but does not have mallinfo
 #if defined(__GNUC__) && defined(__GLIBC__) && !defined(__FreeBSD__) && !defined(__NetBSD__)
-extern "C" struct mallinfo CUSTOM_MALLINFO() {
-  // For now, we return useless stats.
-  struct mallinfo m;
-  m.arena = 0;
-  m.ordblks = 0;
+// Fill in the glibc-style fields (of int or size_t) from a snapshot.
+template <class Mallinfo>
+static Mallinfo makeMallinfo() {
+  const auto s = collectHeapStats();
+  using Field = decltype(Mallinfo::arena);
+  Mallinfo m;
+  m.arena = (Field) s.totalBytes();
+  m.ordblks = (Field) s.freeObjects;
   m.smblks = 0;
   m.hblks = 0;
-  m.hblkhd = 0;
+  m.hblkhd = (Field) s.mmapBytes;
   m.usmblks = 0;
   m.fsmblks = 0;
-  m.uordblks = 0;
-  m.fordblks = 0;
-  m.keepcost = 0;
+  m.uordblks = (Field) s.inUseBytes();
+  m.fordblks = (Field) (s.freeBytes + s.unusedBytes + s.threadCacheBytes);
+  m.keepcost = (Field) s.unusedBytes;
   return m;
 }
+
+extern "C" struct mallinfo CUSTOM_MALLINFO() {
+  return makeMallinfo<struct mallinfo>();
+}
+
+#if __GLIBC_PREREQ(2, 33)
+extern "C" struct mallinfo2 CUSTOM_MALLINFO2() {
+  return makeMallinfo<struct mallinfo2>();
+}
+#endif
 #endif
 
 #if defined(__SVR4)
@@ -525,12 +675,12 @@ ATTRIBUTE_EXPORT void FLATTEN operator delete[](void * ptr, size_t sz)
 // --- Aligned new/delete (C++17) ---
 #if defined(__cpp_aligned_new) && __cpp_aligned_new >= 201606
 ATTRIBUTE_EXPORT void* FLATTEN operator new(std::size_t n, std::align_val_t al) {
-  void* p = CUSTOM_MEMALIGN(n, (std::size_t) al); 
+  void* p = CUSTOM_MEMALIGN((std::size_t) al, n);
   if (!p) throw std::bad_alloc();
   return p;
 }
 ATTRIBUTE_EXPORT void* FLATTEN operator new[](std::size_t n, std::align_val_t al) {
-  void* p = CUSTOM_MEMALIGN(n, (std::size_t) al); 
+  void* p = CUSTOM_MEMALIGN((std::size_t) al, n);
   if (!p) throw std::bad_alloc();
   return p;
 }
@@ -585,7 +735,7 @@ extern "C" void * MYCDECL CUSTOM_RECALLOC (void * p, size_t num, size_t sz)
   void * ptr = CUSTOM_REALLOC (p, n);
   if (ptr) {
     // Clear out the memory.
-    memset (ptr, 0, n);
+    HL::bulk_zero (ptr, n);
   }
   return ptr;
 }